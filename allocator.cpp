@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cassert>
+#include <malloc.h>
+#include "allocator.h"
+
+struct HostAllocator::Header
+{
+    void *block;
+    size_t size;
+    size_t capacity;
+    VkObjectType objectType;
+    uint32_t sizeClass;
+    VkSystemAllocationScope scope;
+    Source source;
+};
+
+struct HostAllocator::Context
+{
+    HostAllocator *allocator;
+    VkObjectType objectType;
+    VkAllocationCallbacks callbacks;
+};
+
+struct HostAllocator::Heap
+{
+    std::mutex mutex;
+    std::array<void *, sizeClassCount> freeLists = {};
+    std::vector<void *> chunks;
+    char *arena = nullptr;
+    size_t arenaOffset = 0;
+    size_t arenaLiveCount = 0;
+};
+
+static constexpr size_t minAlignment = 16;
+static constexpr size_t headerSize = (sizeof(void *) * 3 + 16 + minAlignment - 1) & ~(minAlignment - 1);
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static const char *objectTypeName(VkObjectType objectType)
+{
+    switch (objectType)
+    {
+    case VK_OBJECT_TYPE_UNKNOWN: return "unknown";
+    case VK_OBJECT_TYPE_INSTANCE: return "instance";
+    case VK_OBJECT_TYPE_PHYSICAL_DEVICE: return "physical device";
+    case VK_OBJECT_TYPE_DEVICE: return "device";
+    case VK_OBJECT_TYPE_QUEUE: return "queue";
+    case VK_OBJECT_TYPE_SEMAPHORE: return "semaphore";
+    case VK_OBJECT_TYPE_COMMAND_BUFFER: return "command buffer";
+    case VK_OBJECT_TYPE_FENCE: return "fence";
+    case VK_OBJECT_TYPE_DEVICE_MEMORY: return "device memory";
+    case VK_OBJECT_TYPE_BUFFER: return "buffer";
+    case VK_OBJECT_TYPE_IMAGE: return "image";
+    case VK_OBJECT_TYPE_EVENT: return "event";
+    case VK_OBJECT_TYPE_QUERY_POOL: return "query pool";
+    case VK_OBJECT_TYPE_BUFFER_VIEW: return "buffer view";
+    case VK_OBJECT_TYPE_IMAGE_VIEW: return "image view";
+    case VK_OBJECT_TYPE_SHADER_MODULE: return "shader module";
+    case VK_OBJECT_TYPE_PIPELINE_CACHE: return "pipeline cache";
+    case VK_OBJECT_TYPE_PIPELINE_LAYOUT: return "pipeline layout";
+    case VK_OBJECT_TYPE_RENDER_PASS: return "render pass";
+    case VK_OBJECT_TYPE_PIPELINE: return "pipeline";
+    case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT: return "descriptor set layout";
+    case VK_OBJECT_TYPE_SAMPLER: return "sampler";
+    case VK_OBJECT_TYPE_DESCRIPTOR_POOL: return "descriptor pool";
+    case VK_OBJECT_TYPE_DESCRIPTOR_SET: return "descriptor set";
+    case VK_OBJECT_TYPE_FRAMEBUFFER: return "framebuffer";
+    case VK_OBJECT_TYPE_COMMAND_POOL: return "command pool";
+    case VK_OBJECT_TYPE_SURFACE_KHR: return "surface";
+    case VK_OBJECT_TYPE_SWAPCHAIN_KHR: return "swapchain";
+    case VK_OBJECT_TYPE_DEBUG_REPORT_CALLBACK_EXT: return "debug report callback";
+    default: return "other";
+    }
+}
+
+static const char *scopeName(uint32_t scope)
+{
+    switch (scope)
+    {
+    case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "command";
+    case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "object";
+    case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "cache";
+    case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "device";
+    case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "instance";
+    default: return "?";
+    }
+}
+
+static void update(HostAllocator::Usage& usage, size_t size, bool allocated)
+{
+    if (allocated)
+    {
+        usage.bytes += size;
+        usage.peakBytes = std::max(usage.peakBytes, usage.bytes);
+        ++usage.allocationCount;
+        ++usage.totalAllocations;
+    }
+    else
+    {
+        assert(usage.bytes >= size);
+        usage.bytes -= size;
+        --usage.allocationCount;
+    }
+}
+
+HostAllocator::HostAllocator()
+{
+    static_assert(sizeof(Header) <= headerSize, "header doesn't fit");
+    for (auto& heap: heaps)
+        heap = std::make_unique<Heap>();
+    // Command-scope allocations live only for the duration of a Vulkan command
+    heaps[VK_SYSTEM_ALLOCATION_SCOPE_COMMAND]->arena = (char *)_aligned_malloc(arenaSize, minAlignment);
+}
+
+HostAllocator::~HostAllocator()
+{
+    if (totalUsage.allocationCount)
+    {
+        const std::string message = "host allocator: " + std::to_string(totalUsage.allocationCount) +
+            " allocations (" + std::to_string(totalUsage.bytes) + " bytes) not freed\n";
+        OutputDebugStringA(message.c_str());
+    }
+    for (auto& heap: heaps)
+    {
+        for (void *chunk: heap->chunks)
+            _aligned_free(chunk);
+        _aligned_free(heap->arena);
+    }
+}
+
+const VkAllocationCallbacks *HostAllocator::callbacks(VkObjectType objectType)
+{
+    std::lock_guard<std::mutex> lock(contextMutex);
+    std::unique_ptr<Context>& context = contexts[objectType];
+    if (!context)
+    {
+        context = std::make_unique<Context>();
+        context->allocator = this;
+        context->objectType = objectType;
+        context->callbacks.pUserData = context.get();
+        context->callbacks.pfnAllocation = allocationCallback;
+        context->callbacks.pfnReallocation = reallocationCallback;
+        context->callbacks.pfnFree = freeCallback;
+        context->callbacks.pfnInternalAllocation = internalAllocationCallback;
+        context->callbacks.pfnInternalFree = internalFreeCallback;
+    }
+    return &context->callbacks;
+}
+
+HostAllocator::Usage HostAllocator::getTotalUsage() const
+{
+    std::lock_guard<std::mutex> lock(statMutex);
+    return totalUsage;
+}
+
+HostAllocator::Usage HostAllocator::getScopeUsage(VkSystemAllocationScope scope) const
+{
+    std::lock_guard<std::mutex> lock(statMutex);
+    return scopeUsage[scope];
+}
+
+HostAllocator::Usage HostAllocator::getObjectUsage(VkObjectType objectType) const
+{
+    std::lock_guard<std::mutex> lock(statMutex);
+    auto it = objectUsage.find(objectType);
+    return (it != objectUsage.end()) ? it->second : Usage();
+}
+
+HostAllocator::Usage HostAllocator::getInternalUsage(VkSystemAllocationScope scope) const
+{
+    std::lock_guard<std::mutex> lock(statMutex);
+    return internalUsage[scope];
+}
+
+void HostAllocator::dumpStatistics() const
+{
+    std::lock_guard<std::mutex> lock(statMutex);
+    char line[256];
+    std::string report = "host allocator statistics:\n";
+    snprintf(line, sizeof(line), "  total: %zu bytes in %zu allocations, peak %zu bytes, %zu allocations made\n",
+        totalUsage.bytes, totalUsage.allocationCount, totalUsage.peakBytes, totalUsage.totalAllocations);
+    report += line;
+    for (uint32_t scope = 0; scope < scopeCount; ++scope)
+    {
+        const Usage& usage = scopeUsage[scope];
+        snprintf(line, sizeof(line), "  %s scope: %zu bytes, peak %zu bytes, %zu allocations made, internal peak %zu bytes\n",
+            scopeName(scope), usage.bytes, usage.peakBytes, usage.totalAllocations, internalUsage[scope].peakBytes);
+        report += line;
+    }
+    for (auto const& it: objectUsage)
+    {
+        snprintf(line, sizeof(line), "  %s (%d): %zu bytes, peak %zu bytes, %zu allocations made\n",
+            objectTypeName(it.first), (int)it.first, it.second.bytes, it.second.peakBytes, it.second.totalAllocations);
+        report += line;
+    }
+    OutputDebugStringA(report.c_str());
+}
+
+void *HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope, VkObjectType objectType)
+{
+    if (!size)
+        return nullptr;
+    alignment = std::max(alignment, minAlignment);
+    // Chunks, arena and system blocks come from _aligned_malloc(minAlignment),
+    // and pool and arena blocks keep that alignment, so this is the worst-case padding
+    size_t blockSize = headerSize + size + alignment - minAlignment;
+    uint32_t sizeClass = 0;
+    Source source;
+    Heap& heap = *heaps[scope];
+    char *block = (char *)allocateBlock(heap, blockSize, sizeClass, source);
+    if (!block)
+        return nullptr;
+    char *memory = (char *)alignUp((size_t)block + headerSize, alignment);
+    Header *header = (Header *)(memory - headerSize);
+    header->block = block;
+    header->size = size;
+    header->capacity = (size_t)(block + blockSize - memory);
+    header->objectType = objectType;
+    header->sizeClass = sizeClass;
+    header->scope = scope;
+    header->source = source;
+    track(header, true);
+    return memory;
+}
+
+void *HostAllocator::reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope, VkObjectType objectType)
+{
+    if (!original)
+        return allocate(size, alignment, scope, objectType);
+    if (!size)
+    {
+        free(original);
+        return nullptr;
+    }
+    Header *header = (Header *)((char *)original - headerSize);
+    if ((size <= header->capacity) && ((size_t)original % alignment == 0))
+    {   // Grow or shrink in place
+        track(header, false);
+        header->size = size;
+        track(header, true);
+        return original;
+    }
+    void *memory = allocate(size, alignment, scope, objectType);
+    if (memory)
+    {
+        memcpy(memory, original, std::min(size, header->size));
+        free(original);
+    }
+    return memory;
+}
+
+void HostAllocator::free(void *memory)
+{
+    if (!memory)
+        return;
+    Header *header = (Header *)((char *)memory - headerSize);
+    track(header, false);
+    freeBlock(*heaps[header->scope], header->block, header->sizeClass, header->source);
+}
+
+void *HostAllocator::allocateBlock(Heap& heap, size_t& blockSize, uint32_t& sizeClass, Source& source)
+{
+    if (blockSize > maxSizeClass)
+    {
+        source = Source::System;
+        return _aligned_malloc(blockSize, minAlignment);
+    }
+    std::lock_guard<std::mutex> lock(heap.mutex);
+    if (heap.arena)
+    {
+        const size_t arenaBlockSize = alignUp(blockSize, minAlignment);
+        if (heap.arenaOffset + arenaBlockSize <= arenaSize)
+        {
+            void *block = heap.arena + heap.arenaOffset;
+            heap.arenaOffset += arenaBlockSize;
+            ++heap.arenaLiveCount;
+            blockSize = arenaBlockSize;
+            source = Source::Arena;
+            return block;
+        }
+    }
+    sizeClass = 0;
+    while ((minSizeClass << sizeClass) < blockSize)
+        ++sizeClass;
+    blockSize = minSizeClass << sizeClass;
+    void *block = heap.freeLists[sizeClass];
+    if (!block)
+    {   // Carve a new chunk into blocks of this class
+        char *chunk = (char *)_aligned_malloc(chunkSize, minAlignment);
+        if (!chunk)
+            return nullptr;
+        heap.chunks.push_back(chunk);
+        for (size_t offset = 0; offset + blockSize <= chunkSize; offset += blockSize)
+        {
+            void *next = heap.freeLists[sizeClass];
+            memcpy(chunk + offset, &next, sizeof(void *));
+            heap.freeLists[sizeClass] = chunk + offset;
+        }
+        block = heap.freeLists[sizeClass];
+    }
+    void *next;
+    memcpy(&next, block, sizeof(void *));
+    heap.freeLists[sizeClass] = next;
+    source = Source::Pool;
+    return block;
+}
+
+void HostAllocator::freeBlock(Heap& heap, void *block, uint32_t sizeClass, Source source)
+{
+    if (Source::System == source)
+    {
+        _aligned_free(block);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(heap.mutex);
+    if (Source::Arena == source)
+    {   // Rewind once every command-scope allocation is released
+        if (0 == --heap.arenaLiveCount)
+            heap.arenaOffset = 0;
+    }
+    else
+    {
+        void *next = heap.freeLists[sizeClass];
+        memcpy(block, &next, sizeof(void *));
+        heap.freeLists[sizeClass] = block;
+    }
+}
+
+void HostAllocator::track(const Header *header, bool allocated)
+{
+    std::lock_guard<std::mutex> lock(statMutex);
+    update(totalUsage, header->size, allocated);
+    update(scopeUsage[header->scope], header->size, allocated);
+    update(objectUsage[header->objectType], header->size, allocated);
+}
+
+void HostAllocator::trackInternal(size_t size, VkSystemAllocationScope scope, bool allocated)
+{
+    std::lock_guard<std::mutex> lock(statMutex);
+    update(internalUsage[scope], size, allocated);
+}
+
+void *VKAPI_PTR HostAllocator::allocationCallback(void *userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    Context *context = (Context *)userData;
+    return context->allocator->allocate(size, alignment, scope, context->objectType);
+}
+
+void *VKAPI_PTR HostAllocator::reallocationCallback(void *userData, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    Context *context = (Context *)userData;
+    return context->allocator->reallocate(original, size, alignment, scope, context->objectType);
+}
+
+void VKAPI_PTR HostAllocator::freeCallback(void *userData, void *memory)
+{
+    Context *context = (Context *)userData;
+    context->allocator->free(memory);
+}
+
+void VKAPI_PTR HostAllocator::internalAllocationCallback(void *userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+    Context *context = (Context *)userData;
+    context->allocator->trackInternal(size, scope, true);
+}
+
+void VKAPI_PTR HostAllocator::internalFreeCallback(void *userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+    Context *context = (Context *)userData;
+    context->allocator->trackInternal(size, scope, false);
+}
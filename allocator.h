@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Host allocator for VkAllocationCallbacks: small allocations are served
+// from per-scope size-class pools, command-scope allocations from a
+// rewinding arena, large ones from the system heap.
+class HostAllocator
+{
+public:
+    struct Usage
+    {
+        size_t bytes = 0;
+        size_t peakBytes = 0;
+        size_t allocationCount = 0;
+        size_t totalAllocations = 0;
+    };
+
+    HostAllocator();
+    ~HostAllocator();
+    const VkAllocationCallbacks *callbacks(VkObjectType objectType);
+    Usage getTotalUsage() const;
+    Usage getScopeUsage(VkSystemAllocationScope scope) const;
+    Usage getObjectUsage(VkObjectType objectType) const;
+    Usage getInternalUsage(VkSystemAllocationScope scope) const;
+    void dumpStatistics() const;
+
+private:
+    enum class Source : uint8_t { Pool, Arena, System };
+    struct Header;
+    struct Context;
+    struct Heap;
+
+    static constexpr uint32_t scopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+    static constexpr uint32_t sizeClassCount = 8;
+    static constexpr size_t minSizeClass = 64;
+    static constexpr size_t maxSizeClass = minSizeClass << (sizeClassCount - 1);
+    static constexpr size_t chunkSize = 64 * 1024;
+    static constexpr size_t arenaSize = 256 * 1024;
+
+    void *allocate(size_t size, size_t alignment, VkSystemAllocationScope scope, VkObjectType objectType);
+    void *reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope, VkObjectType objectType);
+    void free(void *memory);
+    void *allocateBlock(Heap& heap, size_t& blockSize, uint32_t& sizeClass, Source& source);
+    void freeBlock(Heap& heap, void *block, uint32_t sizeClass, Source source);
+    void track(const Header *header, bool allocated);
+    void trackInternal(size_t size, VkSystemAllocationScope scope, bool allocated);
+
+    static void *VKAPI_PTR allocationCallback(void *userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void *VKAPI_PTR reallocationCallback(void *userData, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void VKAPI_PTR freeCallback(void *userData, void *memory);
+    static void VKAPI_PTR internalAllocationCallback(void *userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static void VKAPI_PTR internalFreeCallback(void *userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+    std::array<std::unique_ptr<Heap>, scopeCount> heaps;
+    std::map<VkObjectType, std::unique_ptr<Context>> contexts;
+    std::mutex contextMutex;
+
+    mutable std::mutex statMutex;
+    Usage totalUsage;
+    std::array<Usage, scopeCount> scopeUsage;
+    std::array<Usage, scopeCount> internalUsage;
+    std::map<VkObjectType, Usage> objectUsage;
+};
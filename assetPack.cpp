@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include "assetPack.h"
+
+#define MILLISECOND 1000000
+#define TIMEOUT 2 * MILLISECOND
+
+#define CHECK_SUCCEEDED(result, message)\
+    if (VK_SUCCESS != result)\
+        throw std::runtime_error(message)
+
+typedef std::chrono::steady_clock Clock;
+
+static VkDeviceSize alignUp(VkDeviceSize size, VkDeviceSize alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static VkDeviceSize mipSize(const AssetPackEntry& entry, uint32_t mipLevel)
+{
+    const VkDeviceSize width = std::max(entry.width >> mipLevel, 1u);
+    const VkDeviceSize height = std::max(entry.height >> mipLevel, 1u);
+    return width * height * entry.texelSize;
+}
+
+AssetPack::AssetPack(VkPhysicalDevice physicalDevice_, VkDevice device_, VkQueue transferQueue_, VkCommandBuffer cmdBuffer_,
+    SubmitQueue& submitQueue_, HostAllocator& allocator_, const std::vector<uint32_t>& queueFamilyIndices_,
+    bool externalMemoryHost, const char *fileName):
+    physicalDevice(physicalDevice_),
+    device(device_),
+    transferQueue(transferQueue_),
+    cmdBuffer(cmdBuffer_),
+    submitQueue(submitQueue_),
+    allocator(allocator_),
+    queueFamilyIndices(queueFamilyIndices_)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    VkFenceCreateInfo fenceInfo;
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.pNext = nullptr;
+    fenceInfo.flags = 0;
+    VkResult result = vkCreateFence(device, &fenceInfo, allocator.callbacks(VK_OBJECT_TYPE_FENCE), &fence);
+    CHECK_SUCCEEDED(result, "failed to create fence");
+
+    const Clock::time_point begin = Clock::now();
+    map(fileName);
+    const Clock::time_point mapped = Clock::now();
+    createAssets();
+    createRegions();
+    stats.hostImport = importHostMemory(externalMemoryHost);
+    if (!stats.hostImport)
+        createStagingBuffer();
+    upload();
+    const Clock::time_point end = Clock::now();
+
+    // Mapping and source buffer are not needed once the GPU has copied everything
+    vkDestroyBuffer(device, srcBuffer, allocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+    vkFreeMemory(device, srcMemory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    srcBuffer = VK_NULL_HANDLE;
+    srcMemory = VK_NULL_HANDLE;
+    unmap();
+
+    stats.assetCount = (uint32_t)assets.size();
+    stats.mapTime = std::chrono::duration<float, std::milli>(mapped - begin).count();
+    stats.uploadTime = std::chrono::duration<float, std::milli>(end - mapped).count();
+    const double seconds = std::chrono::duration<double>(end - begin).count();
+    if (seconds > 0.)
+        stats.throughput = stats.bytes / seconds / 1e9;
+}
+
+AssetPack::~AssetPack()
+{
+    for (auto const& asset: assets)
+    {
+        vkDestroyImageView(device, asset.imageView, allocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+        vkDestroyImage(device, asset.image, allocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+        vkDestroyBuffer(device, asset.buffer, allocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        vkFreeMemory(device, asset.memory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    }
+    vkDestroyBuffer(device, srcBuffer, allocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+    vkFreeMemory(device, srcMemory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    vkDestroyFence(device, fence, allocator.callbacks(VK_OBJECT_TYPE_FENCE));
+    unmap();
+}
+
+const AssetPack::Asset *AssetPack::find(const char *name) const
+{
+    auto it = std::find_if(assets.begin(), assets.end(),
+        [name](auto const& asset)
+        {
+            return asset.name == name;
+        });
+    return (it != assets.end()) ? &*it : nullptr;
+}
+
+std::string AssetPack::parseFileName(const char *commandLine)
+{
+    const char *option = commandLine ? strstr(commandLine, "-pack") : nullptr;
+    if (!option)
+        return std::string();
+    const char *begin = option + strlen("-pack");
+    while (' ' == *begin)
+        ++begin;
+    const char *end = begin;
+    while (*end && (*end != ' '))
+        ++end;
+    return std::string(begin, end);
+}
+
+void AssetPack::map(const char *fileName)
+{
+    file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (INVALID_HANDLE_VALUE == file)
+        throw std::runtime_error("failed to open asset pack");
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (size.QuadPart < (LONGLONG)sizeof(AssetPackHeader)))
+        throw std::runtime_error("invalid asset pack");
+    fileSize = (uint64_t)size.QuadPart;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+        throw std::runtime_error("failed to map asset pack");
+    view = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+        throw std::runtime_error("failed to map asset pack");
+    // Ask the memory manager to read ahead instead of faulting in page by page
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (PVOID)view;
+    range.NumberOfBytes = (SIZE_T)fileSize;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+    const AssetPackHeader *header = (const AssetPackHeader *)view;
+    if ((header->magic != ASSET_PACK_MAGIC) ||
+        (header->version != ASSET_PACK_VERSION) ||
+        (header->alignment != ASSET_PACK_ALIGNMENT) ||
+        (header->fileSize != fileSize) ||
+        (sizeof(AssetPackHeader) + header->entryCount * sizeof(AssetPackEntry) > fileSize))
+    {
+        throw std::runtime_error("invalid asset pack");
+    }
+    entries = (const AssetPackEntry *)(view + sizeof(AssetPackHeader));
+    for (uint32_t i = 0; i < header->entryCount; ++i)
+    {
+        const AssetPackEntry& entry = entries[i];
+        if ((entry.offset % ASSET_PACK_ALIGNMENT) || (entry.offset + entry.size > fileSize))
+            throw std::runtime_error("corrupted asset pack");
+    }
+    assets.resize(header->entryCount);
+}
+
+void AssetPack::unmap()
+{
+    if (view)
+        UnmapViewOfFile(view);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    view = nullptr;
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+    entries = nullptr;
+}
+
+void AssetPack::createAssets()
+{   // Shared between transfer and graphics queues without ownership transfers
+    const VkSharingMode sharingMode = (queueFamilyIndices.size() > 1) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    const uint32_t queueFamilyIndexCount = (queueFamilyIndices.size() > 1) ? (uint32_t)queueFamilyIndices.size() : 0;
+    for (uint32_t i = 0; i < (uint32_t)assets.size(); ++i)
+    {
+        const AssetPackEntry& entry = entries[i];
+        Asset& asset = assets[i];
+        asset.name.assign(entry.name, strnlen(entry.name, sizeof(entry.name)));
+        asset.type = (AssetPackEntryType)entry.type;
+        asset.size = entry.size;
+        VkMemoryRequirements memoryRequirements;
+        if (AssetPackImage == entry.type)
+        {
+            VkDeviceSize size = 0;
+            for (uint32_t mipLevel = 0; mipLevel < entry.mipLevels; ++mipLevel)
+                size += mipSize(entry, mipLevel);
+            if (!entry.mipLevels || (size != entry.size))
+                throw std::runtime_error("corrupted asset pack");
+            asset.extent = VkExtent2D{entry.width, entry.height};
+            asset.mipLevels = entry.mipLevels;
+
+            VkImageCreateInfo imageInfo;
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.pNext = nullptr;
+            imageInfo.flags = 0;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = (VkFormat)entry.format;
+            imageInfo.extent = VkExtent3D{entry.width, entry.height, 1};
+            imageInfo.mipLevels = entry.mipLevels;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            imageInfo.sharingMode = sharingMode;
+            imageInfo.queueFamilyIndexCount = queueFamilyIndexCount;
+            imageInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkResult result = vkCreateImage(device, &imageInfo, allocator.callbacks(VK_OBJECT_TYPE_IMAGE), &asset.image);
+            CHECK_SUCCEEDED(result, "failed to create asset image");
+            vkGetImageMemoryRequirements(device, asset.image, &memoryRequirements);
+            asset.memory = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            result = vkBindImageMemory(device, asset.image, asset.memory, 0);
+            CHECK_SUCCEEDED(result, "failed to bind asset image memory");
+
+            VkImageViewCreateInfo imageViewInfo;
+            imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            imageViewInfo.pNext = nullptr;
+            imageViewInfo.flags = 0;
+            imageViewInfo.image = asset.image;
+            imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            imageViewInfo.format = imageInfo.format;
+            imageViewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+            imageViewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+            imageViewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+            imageViewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+            imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageViewInfo.subresourceRange.baseMipLevel = 0;
+            imageViewInfo.subresourceRange.levelCount = entry.mipLevels;
+            imageViewInfo.subresourceRange.baseArrayLayer = 0;
+            imageViewInfo.subresourceRange.layerCount = 1;
+            result = vkCreateImageView(device, &imageViewInfo, allocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &asset.imageView);
+            CHECK_SUCCEEDED(result, "failed to create asset image view");
+        }
+        else
+        {
+            VkBufferCreateInfo bufferInfo;
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.pNext = nullptr;
+            bufferInfo.flags = 0;
+            bufferInfo.size = std::max<VkDeviceSize>(entry.size, 4);
+            bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferInfo.sharingMode = sharingMode;
+            bufferInfo.queueFamilyIndexCount = queueFamilyIndexCount;
+            bufferInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+            VkResult result = vkCreateBuffer(device, &bufferInfo, allocator.callbacks(VK_OBJECT_TYPE_BUFFER), &asset.buffer);
+            CHECK_SUCCEEDED(result, "failed to create asset buffer");
+            vkGetBufferMemoryRequirements(device, asset.buffer, &memoryRequirements);
+            asset.memory = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            result = vkBindBufferMemory(device, asset.buffer, asset.memory, 0);
+            CHECK_SUCCEEDED(result, "failed to bind asset buffer memory");
+        }
+        stats.bytes += entry.size;
+    }
+}
+
+void AssetPack::createRegions()
+{   // Mip level is the unit of an image copy, buffers are split to fit the staging buffer
+    stagingSize = stagingBufferSize;
+    for (uint32_t i = 0; i < (uint32_t)assets.size(); ++i)
+    {
+        if (AssetPackImage == entries[i].type)
+            stagingSize = std::max(stagingSize, alignUp(mipSize(entries[i], 0), copyOffsetAlignment));
+    }
+    for (uint32_t i = 0; i < (uint32_t)assets.size(); ++i)
+    {
+        const AssetPackEntry& entry = entries[i];
+        VkDeviceSize offset = 0;
+        if (AssetPackImage == entry.type)
+        {
+            for (uint32_t mipLevel = 0; mipLevel < entry.mipLevels; ++mipLevel)
+            {
+                const VkDeviceSize size = mipSize(entry, mipLevel);
+                regions.push_back(Region{i, mipLevel, entry.offset + offset, 0, size});
+                offset += size;
+            }
+        }
+        else
+        {
+            while (offset < entry.size)
+            {
+                const VkDeviceSize size = std::min(entry.size - offset, stagingSize);
+                regions.push_back(Region{i, 0, entry.offset + offset, offset, size});
+                offset += size;
+            }
+        }
+    }
+}
+
+bool AssetPack::importHostMemory(bool externalMemoryHost)
+{
+    if (!externalMemoryHost)
+        return false;
+    PFN_vkGetMemoryHostPointerPropertiesEXT vkGetMemoryHostPointerPropertiesEXT =
+        (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(device, "vkGetMemoryHostPointerPropertiesEXT");
+    if (!vkGetMemoryHostPointerPropertiesEXT)
+        return false;
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties;
+    hostProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+    hostProperties.pNext = nullptr;
+    hostProperties.minImportedHostPointerAlignment = 0;
+    VkPhysicalDeviceProperties2 properties;
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &hostProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    // View is aligned to allocation granularity, pack tool pads the file
+    const VkDeviceSize alignment = hostProperties.minImportedHostPointerAlignment;
+    if (!alignment || (ASSET_PACK_ALIGNMENT % alignment) || (fileSize % alignment))
+        return false;
+
+    VkMemoryHostPointerPropertiesEXT hostPointerProperties;
+    hostPointerProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+    hostPointerProperties.pNext = nullptr;
+    hostPointerProperties.memoryTypeBits = 0;
+    VkResult result = vkGetMemoryHostPointerPropertiesEXT(device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+        view, &hostPointerProperties);
+    if ((result != VK_SUCCESS) || !hostPointerProperties.memoryTypeBits)
+        return false;
+
+    VkExternalMemoryBufferCreateInfo externalMemoryInfo;
+    externalMemoryInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    externalMemoryInfo.pNext = nullptr;
+    externalMemoryInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    VkBufferCreateInfo bufferInfo;
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = &externalMemoryInfo;
+    bufferInfo.flags = 0;
+    bufferInfo.size = fileSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = 0;
+    bufferInfo.pQueueFamilyIndices = nullptr;
+    result = vkCreateBuffer(device, &bufferInfo, allocator.callbacks(VK_OBJECT_TYPE_BUFFER), &srcBuffer);
+    CHECK_SUCCEEDED(result, "failed to create buffer");
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, srcBuffer, &memoryRequirements);
+    const uint32_t memoryTypeBits = memoryRequirements.memoryTypeBits & hostPointerProperties.memoryTypeBits;
+
+    VkImportMemoryHostPointerInfoEXT importInfo;
+    importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+    importInfo.pNext = nullptr;
+    importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    importInfo.pHostPointer = (void *)view;
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = &importInfo;
+    memoryAllocateInfo.allocationSize = fileSize;
+    memoryAllocateInfo.memoryTypeIndex = memoryTypeBits ? chooseMemoryType(memoryTypeBits, 0) : 0;
+    result = memoryTypeBits ? vkAllocateMemory(device, &memoryAllocateInfo, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &srcMemory) :
+        VK_ERROR_INVALID_EXTERNAL_HANDLE;
+    if (VK_SUCCESS == result)
+        result = vkBindBufferMemory(device, srcBuffer, srcMemory, 0);
+    if (result != VK_SUCCESS)
+    {   // Some drivers refuse file-backed pages, fall back to staging
+        OutputDebugStringA("failed to import asset pack mapping, using staging buffer\n");
+        vkDestroyBuffer(device, srcBuffer, allocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        vkFreeMemory(device, srcMemory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+        srcBuffer = VK_NULL_HANDLE;
+        srcMemory = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+void AssetPack::createStagingBuffer()
+{
+    stagingSize = std::min(stagingSize, alignUp(fileSize, copyOffsetAlignment));
+    VkBufferCreateInfo bufferInfo;
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.flags = 0;
+    bufferInfo.size = stagingSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = 0;
+    bufferInfo.pQueueFamilyIndices = nullptr;
+    VkResult result = vkCreateBuffer(device, &bufferInfo, allocator.callbacks(VK_OBJECT_TYPE_BUFFER), &srcBuffer);
+    CHECK_SUCCEEDED(result, "failed to create staging buffer");
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, srcBuffer, &memoryRequirements);
+    srcMemory = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    result = vkBindBufferMemory(device, srcBuffer, srcMemory, 0);
+    CHECK_SUCCEEDED(result, "failed to bind staging buffer memory");
+    result = vkMapMemory(device, srcMemory, 0, VK_WHOLE_SIZE, 0, (void **)&stagingData);
+    CHECK_SUCCEEDED(result, "failed to map staging buffer memory");
+}
+
+void AssetPack::upload()
+{
+    beginCommandBuffer();
+    imageBarriers(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkDeviceSize stagingOffset = 0;
+    for (auto const& region: regions)
+    {
+        VkDeviceSize srcOffset = region.fileOffset;
+        if (stagingData)
+        {   // The only CPU copy: from the mapped file straight into staging memory
+            if (stagingOffset + region.size > stagingSize)
+            {
+                flush();
+                beginCommandBuffer();
+                stagingOffset = 0;
+            }
+            memcpy(stagingData + stagingOffset, view + region.fileOffset, (size_t)region.size);
+            srcOffset = stagingOffset;
+            stagingOffset = alignUp(stagingOffset + region.size, copyOffsetAlignment);
+        }
+        const Asset& asset = assets[region.assetIndex];
+        if (AssetPackImage == asset.type)
+        {
+            VkBufferImageCopy copyRegion;
+            copyRegion.bufferOffset = srcOffset;
+            copyRegion.bufferRowLength = 0;
+            copyRegion.bufferImageHeight = 0;
+            copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegion.imageSubresource.mipLevel = region.mipLevel;
+            copyRegion.imageSubresource.baseArrayLayer = 0;
+            copyRegion.imageSubresource.layerCount = 1;
+            copyRegion.imageOffset = VkOffset3D{0, 0, 0};
+            copyRegion.imageExtent = VkExtent3D{
+                std::max(asset.extent.width >> region.mipLevel, 1u),
+                std::max(asset.extent.height >> region.mipLevel, 1u),
+                1};
+            vkCmdCopyBufferToImage(cmdBuffer, srcBuffer, asset.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+        }
+        else
+        {
+            VkBufferCopy copyRegion;
+            copyRegion.srcOffset = srcOffset;
+            copyRegion.dstOffset = region.dstOffset;
+            copyRegion.size = region.size;
+            vkCmdCopyBuffer(cmdBuffer, srcBuffer, asset.buffer, 1, &copyRegion);
+        }
+    }
+    // Graphics queue is synchronized by the host waiting for the fence
+    imageBarriers(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    flush();
+}
+
+void AssetPack::beginCommandBuffer()
+{
+    VkCommandBufferBeginInfo cmdBufferBeginInfo;
+    cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cmdBufferBeginInfo.pNext = nullptr;
+    cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+    vkResetCommandBuffer(cmdBuffer, 0);
+    VkResult result = vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
+    CHECK_SUCCEEDED(result, "failed to begin transfer command buffer");
+}
+
+void AssetPack::flush()
+{
+    VkResult result = vkEndCommandBuffer(cmdBuffer);
+    CHECK_SUCCEEDED(result, "failed to end transfer command buffer");
+    SubmitQueue::Batch batch;
+    batch.queue = transferQueue;
+    batch.cmdBuffers.push_back(cmdBuffer);
+    batch.fence = fence;
+    submitQueue.submit(std::move(batch));
+    ++stats.submitCount;
+    do
+    {
+        result = vkWaitForFences(device, 1, &fence, VK_FALSE, TIMEOUT);
+        if (VK_TIMEOUT == result)
+            submitQueue.checkError(); // Fence is never signaled if the submit failed
+    } while (VK_TIMEOUT == result);
+    CHECK_SUCCEEDED(result, "wait for fence failed");
+    vkResetFences(device, 1, &fence);
+}
+
+void AssetPack::imageBarriers(VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+    VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+{
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    for (auto const& asset: assets)
+    {
+        if (asset.type != AssetPackImage)
+            continue;
+        VkImageMemoryBarrier imageBarrier;
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.pNext = nullptr;
+        imageBarrier.srcAccessMask = srcAccessMask;
+        imageBarrier.dstAccessMask = dstAccessMask;
+        imageBarrier.oldLayout = oldLayout;
+        imageBarrier.newLayout = newLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = asset.image;
+        imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        imageBarrier.subresourceRange.baseMipLevel = 0;
+        imageBarrier.subresourceRange.levelCount = asset.mipLevels;
+        imageBarrier.subresourceRange.baseArrayLayer = 0;
+        imageBarrier.subresourceRange.layerCount = 1;
+        imageBarriers.push_back(imageBarrier);
+    }
+    if (!imageBarriers.empty())
+    {
+        vkCmdPipelineBarrier(cmdBuffer, srcStageMask, dstStageMask, 0,
+            0, nullptr, 0, nullptr, (uint32_t)imageBarriers.size(), imageBarriers.data());
+    }
+}
+
+uint32_t AssetPack::chooseMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const
+{
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        if ((memoryTypeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags))
+            return i;
+    }
+    throw std::runtime_error("failed to find suitable memory type");
+}
+
+VkDeviceMemory AssetPack::allocateMemory(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags flags)
+{
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = nullptr;
+    memoryAllocateInfo.allocationSize = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = chooseMemoryType(memoryRequirements.memoryTypeBits, flags);
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkResult result = vkAllocateMemory(device, &memoryAllocateInfo, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &memory);
+    CHECK_SUCCEEDED(result, "failed to allocate memory");
+    return memory;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <windows.h>
+#include <vulkan/vulkan.h>
+#include "assetPackFormat.h"
+#include "allocator.h"
+#include "submitQueue.h"
+
+// Loads a binary asset pack built by packTool. The file is memory-mapped
+// and its blobs go to the GPU without parsing or intermediate copies:
+// with VK_EXT_external_memory_host the mapping itself is imported as a
+// transfer source, otherwise regions are copied once from the mapping
+// into a staging buffer. Uploads are recorded on the transfer queue.
+class AssetPack
+{
+public:
+    struct Asset
+    {
+        std::string name;
+        AssetPackEntryType type;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkExtent2D extent = {0, 0};
+        uint32_t mipLevels = 0;
+    };
+
+    struct Statistics
+    {
+        uint64_t bytes = 0;
+        uint32_t assetCount = 0;
+        uint32_t submitCount = 0;
+        bool hostImport = false;
+        float mapTime = 0.f; // Milliseconds
+        float uploadTime = 0.f;
+        double throughput = 0.; // GB/s from open to upload complete
+    };
+
+    AssetPack(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue transferQueue, VkCommandBuffer cmdBuffer,
+        SubmitQueue& submitQueue, HostAllocator& allocator, const std::vector<uint32_t>& queueFamilyIndices,
+        bool externalMemoryHost, const char *fileName);
+    ~AssetPack();
+    const Asset *find(const char *name) const;
+    const std::vector<Asset>& getAssets() const { return assets; }
+    Statistics getStatistics() const { return stats; }
+    static std::string parseFileName(const char *commandLine);
+
+private:
+    static constexpr VkDeviceSize stagingBufferSize = 64 * 1024 * 1024;
+    static constexpr VkDeviceSize copyOffsetAlignment = 256;
+
+    struct Region
+    {
+        uint32_t assetIndex;
+        uint32_t mipLevel;
+        VkDeviceSize fileOffset;
+        VkDeviceSize dstOffset; // Buffer only
+        VkDeviceSize size;
+    };
+
+    void map(const char *fileName);
+    void unmap();
+    void createAssets();
+    void createRegions();
+    bool importHostMemory(bool externalMemoryHost);
+    void createStagingBuffer();
+    void upload();
+    void beginCommandBuffer();
+    void flush();
+    void imageBarriers(VkImageLayout oldLayout, VkImageLayout newLayout,
+        VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+        VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+    uint32_t chooseMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const;
+    VkDeviceMemory allocateMemory(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags flags);
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue transferQueue;
+    VkCommandBuffer cmdBuffer;
+    SubmitQueue& submitQueue;
+    HostAllocator& allocator;
+    std::vector<uint32_t> queueFamilyIndices;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    const uint8_t *view = nullptr;
+    uint64_t fileSize = 0;
+    const AssetPackEntry *entries = nullptr;
+
+    std::vector<Asset> assets;
+    std::vector<Region> regions;
+    VkBuffer srcBuffer = VK_NULL_HANDLE; // Imported mapping or staging buffer
+    VkDeviceMemory srcMemory = VK_NULL_HANDLE;
+    VkDeviceSize stagingSize = 0;
+    uint8_t *stagingData = nullptr;
+    VkFence fence = VK_NULL_HANDLE;
+    Statistics stats;
+};
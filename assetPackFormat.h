@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+
+// Binary asset pack layout, shared by the loader and the pack tool:
+// header, entry index, then GPU-ready blobs. Every blob starts at a
+// multiple of the pack alignment, and the file is padded to it, so that
+// the whole mapping can be imported as host memory and blobs copied
+// straight to their destination without realignment.
+#define ASSET_PACK_MAGIC 0x4B505641 // "AVPK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 65536 // Covers allocation granularity and minImportedHostPointerAlignment
+
+enum AssetPackEntryType : uint32_t
+{
+    AssetPackBuffer, // Vertex, index or any other raw buffer data
+    AssetPackImage // 2D image, mip levels packed tightly one after another
+};
+
+struct AssetPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+    uint64_t fileSize;
+};
+
+struct AssetPackEntry
+{
+    char name[48];
+    uint32_t type;
+    uint32_t format; // VkFormat of image
+    uint32_t width, height;
+    uint32_t mipLevels;
+    uint32_t texelSize; // Bytes
+    uint64_t offset; // From the beginning of the file
+    uint64_t size;
+};
+
+// Meshes are stored as buffer entries named <mesh>.mesh, .vertices, .indices,
+// .meshlets, .meshletVertices and .meshletTriangles. Vertices are quantized:
+// positions are unorm16 within the mesh bounds, normals are octahedral
+// snorm16 and texture coordinates are half floats.
+struct AssetPackMesh
+{
+    float boundsMin[3];
+    float boundsScale[3]; // position = boundsMin + unorm * boundsScale
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize; // 2 or 4 bytes
+    uint32_t meshletCount;
+};
+
+struct AssetPackVertex
+{
+    uint16_t position[4]; // w is padding
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+struct AssetPackMeshlet
+{
+    float center[3]; // Bounding sphere
+    float radius;
+    uint32_t vertexOffset; // Into .meshletVertices
+    uint32_t triangleOffset; // Into .meshletTriangles, three uint8_t local indices per triangle
+    uint16_t vertexCount;
+    uint16_t triangleCount;
+};
+
+static_assert(sizeof(AssetPackHeader) == 24, "unexpected asset pack header size");
+static_assert(sizeof(AssetPackEntry) == 88, "unexpected asset pack entry size");
+static_assert(sizeof(AssetPackVertex) == 16, "unexpected asset pack vertex size");
+static_assert(sizeof(AssetPackMeshlet) == 28, "unexpected asset pack meshlet size");
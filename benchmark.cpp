@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <windows.h>
+#include "benchmark.h"
+
+static const char *stageNames[Benchmark::StageCount] = {
+    "onPaint",
+    "aquireNextImage",
+    "record",
+    "submit",
+    "present",
+    "waitForPresentComplete"
+};
+
+Benchmark::Timing::Timing(Benchmark *benchmark_, Stage stage_):
+    benchmark(benchmark_),
+    stage(stage_),
+    begin(benchmark_ ? Benchmark::now() : 0)
+{}
+
+Benchmark::Timing::~Timing()
+{
+    if (benchmark && (benchmark->frame >= benchmark->warmupFrames))
+        benchmark->samples[stage].push_back(Benchmark::now() - begin);
+}
+
+Benchmark::Benchmark(uint32_t warmupFrames_, uint32_t frameCount_):
+    warmupFrames(warmupFrames_),
+    frameCount(frameCount_)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    nanosecondsPerTick = 1e9 / frequency.QuadPart;
+    for (auto& stageSamples: samples)
+        stageSamples.reserve(frameCount);
+}
+
+bool Benchmark::nextFrame()
+{
+    return ++frame < warmupFrames + frameCount;
+}
+
+void Benchmark::addMetric(const std::string& name, double value, const char *unit)
+{
+    metrics.push_back(Metric{name, value, unit});
+}
+
+std::string Benchmark::getReport() const
+{
+    char line[256];
+    snprintf(line, sizeof(line), "CPU time per frame over %u frames (%u warm-up), ns:\n", frameCount, warmupFrames);
+    std::string report = line;
+    snprintf(line, sizeof(line), "%-24s %12s %12s %12s %12s %12s\n", "stage", "mean", "median", "p99", "min", "max");
+    report += line;
+    for (uint32_t stage = 0; stage < StageCount; ++stage)
+    {
+        std::vector<int64_t> sorted = samples[stage];
+        if (sorted.empty())
+            continue;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.;
+        for (int64_t ticks: sorted)
+            sum += (double)ticks;
+        const size_t p99 = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+        snprintf(line, sizeof(line), "%-24s %12.0f %12.0f %12.0f %12.0f %12.0f\n", stageNames[stage],
+            sum / sorted.size() * nanosecondsPerTick,
+            sorted[sorted.size() / 2] * nanosecondsPerTick,
+            sorted[p99] * nanosecondsPerTick,
+            sorted.front() * nanosecondsPerTick,
+            sorted.back() * nanosecondsPerTick);
+        report += line;
+    }
+    for (const Metric& metric: metrics)
+    {
+        snprintf(line, sizeof(line), "%s: %.3f %s\n", metric.name.c_str(), metric.value, metric.unit);
+        report += line;
+    }
+    return report;
+}
+
+bool Benchmark::writeReport(const char *fileName) const
+{
+    const std::string report = getReport();
+    OutputDebugStringA(report.c_str());
+    std::ofstream file(fileName);
+    if (!file)
+        return false;
+    file << report;
+    return file.good();
+}
+
+uint32_t Benchmark::parseFrameCount(const char *commandLine)
+{
+    const char *option = commandLine ? strstr(commandLine, "-benchmark") : nullptr;
+    if (!option)
+        return 0;
+    const long frameCount = strtol(option + strlen("-benchmark"), nullptr, 10);
+    return (frameCount > 0) ? (uint32_t)frameCount : 1000;
+}
+
+int64_t Benchmark::now()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Collects per-frame CPU timings of frame stages. Run the sample with
+// "-benchmark <frames>", optionally against the mock ICD, to measure
+// pure CPU-side frame overhead.
+class Benchmark
+{
+public:
+    enum Stage : uint32_t
+    {
+        Paint, Acquire, Record, Submit, Present, WaitForPresent,
+        StageCount
+    };
+
+    class Timing
+    {
+    public:
+        Timing(Benchmark *benchmark, Stage stage);
+        ~Timing();
+
+    private:
+        Benchmark *benchmark;
+        Stage stage;
+        int64_t begin;
+    };
+
+    Benchmark(uint32_t warmupFrames, uint32_t frameCount);
+    bool nextFrame();
+    void addMetric(const std::string& name, double value, const char *unit);
+    std::string getReport() const;
+    bool writeReport(const char *fileName) const;
+    static uint32_t parseFrameCount(const char *commandLine);
+
+private:
+    struct Metric
+    {
+        std::string name;
+        double value;
+        const char *unit;
+    };
+
+    static int64_t now();
+
+    uint32_t warmupFrames;
+    uint32_t frameCount;
+    uint32_t frame = 0;
+    double nanosecondsPerTick;
+    std::array<std::vector<int64_t>, StageCount> samples;
+    std::vector<Metric> metrics;
+};
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include "dynamicResolution.h"
+
+#define CHECK_SUCCEEDED(result, message)\
+    if (VK_SUCCESS != result)\
+        throw std::runtime_error(message)
+
+DynamicResolution::DynamicResolution(VkPhysicalDevice physicalDevice_, VkDevice device_, HostAllocator& allocator_,
+    VkFormat format, uint32_t width_, uint32_t height_,
+    float targetFrameTime_, float minScale_, float maxScale_, bool dynamicRendering):
+    physicalDevice(physicalDevice_),
+    device(device_),
+    allocator(allocator_),
+    width(width_),
+    height(height_),
+    targetFrameTime(targetFrameTime_),
+    minScale(minScale_),
+    maxScale(maxScale_),
+    scale(maxScale_)
+{
+    createImage(format);
+    if (!dynamicRendering)
+    {
+        createRenderPass(format);
+        createFramebuffer();
+    }
+}
+
+DynamicResolution::~DynamicResolution()
+{
+    vkDestroyFramebuffer(device, framebuffer, allocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+    vkDestroyRenderPass(device, renderPass, allocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
+    vkDestroyImageView(device, imageView, allocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+    vkDestroyImage(device, image, allocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+    vkFreeMemory(device, memory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+}
+
+bool DynamicResolution::supported(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+    const VkFormatFeatureFlags requiredFeatures =
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+        VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+}
+
+void DynamicResolution::update(float gpuFrameTime)
+{
+    if (gpuFrameTime <= 0.f)
+        return; // No timestamps yet
+    if (averageFrameTime > 0.f)
+        averageFrameTime += (gpuFrameTime - averageFrameTime) * smoothing;
+    else
+        averageFrameTime = gpuFrameTime;
+    const float ratio = targetFrameTime / averageFrameTime;
+    if (std::fabs(ratio - 1.f) < deadband)
+        return;
+    // GPU cost is roughly proportional to pixel count, i.e. to the square of the scale
+    float newScale = scale * std::sqrt(ratio);
+    newScale = std::min(std::max(newScale, scale - maxStep), scale + maxStep);
+    scale = std::min(std::max(newScale, minScale), maxScale);
+}
+
+void DynamicResolution::recordUpscale(VkCommandBuffer cmdBuffer, VkImage dstImage, VkExtent2D dstExtent) const
+{   // Render pass leaves the offscreen image in TRANSFER_SRC_OPTIMAL layout
+    VkImageMemoryBarrier imageBarrier;
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.pNext = nullptr;
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = dstImage;
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = 1;
+    // Chains with the image acquire semaphore wait at the color attachment output stage
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    const VkExtent2D renderExtent = getRenderExtent();
+    VkImageBlit region;
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.mipLevel = 0;
+    region.srcSubresource.baseArrayLayer = 0;
+    region.srcSubresource.layerCount = 1;
+    region.srcOffsets[0] = VkOffset3D{0, 0, 0};
+    region.srcOffsets[1] = VkOffset3D{(int32_t)renderExtent.width, (int32_t)renderExtent.height, 1};
+    region.dstSubresource = region.srcSubresource;
+    region.dstOffsets[0] = VkOffset3D{0, 0, 0};
+    region.dstOffsets[1] = VkOffset3D{(int32_t)dstExtent.width, (int32_t)dstExtent.height, 1};
+    vkCmdBlitImage(cmdBuffer,
+        image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region, VK_FILTER_LINEAR);
+
+    imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier.dstAccessMask = 0;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
+VkExtent2D DynamicResolution::getRenderExtent() const
+{
+    const uint32_t renderWidth = (uint32_t)std::lround(width * scale);
+    const uint32_t renderHeight = (uint32_t)std::lround(height * scale);
+    return VkExtent2D{
+        std::min(std::max(renderWidth, 1u), width),
+        std::min(std::max(renderHeight, 1u), height)
+    };
+}
+
+uint32_t DynamicResolution::chooseMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const
+{
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        if ((memoryTypeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags))
+            return i;
+    }
+    throw std::runtime_error("failed to find suitable memory type");
+}
+
+void DynamicResolution::createImage(VkFormat format)
+{   // Allocated at full size, only the top-left render extent is used
+    VkImageCreateInfo imageInfo;
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.pNext = nullptr;
+    imageInfo.flags = 0;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = VkExtent3D{width, height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.queueFamilyIndexCount = 0;
+    imageInfo.pQueueFamilyIndices = nullptr;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult result = vkCreateImage(device, &imageInfo, allocator.callbacks(VK_OBJECT_TYPE_IMAGE), &image);
+    CHECK_SUCCEEDED(result, "failed to create offscreen image");
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = nullptr;
+    memoryAllocateInfo.allocationSize = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = chooseMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    result = vkAllocateMemory(device, &memoryAllocateInfo, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &memory);
+    CHECK_SUCCEEDED(result, "failed to allocate offscreen image memory");
+    result = vkBindImageMemory(device, image, memory, 0);
+    CHECK_SUCCEEDED(result, "failed to bind offscreen image memory");
+
+    VkImageViewCreateInfo imageViewInfo;
+    imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewInfo.pNext = nullptr;
+    imageViewInfo.flags = 0;
+    imageViewInfo.image = image;
+    imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewInfo.format = format;
+    imageViewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageViewInfo.subresourceRange.baseMipLevel = 0;
+    imageViewInfo.subresourceRange.levelCount = 1;
+    imageViewInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewInfo.subresourceRange.layerCount = 1;
+    result = vkCreateImageView(device, &imageViewInfo, allocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &imageView);
+    CHECK_SUCCEEDED(result, "failed to create offscreen image view");
+}
+
+void DynamicResolution::createRenderPass(VkFormat format)
+{
+    VkAttachmentReference colorAttachment{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentDescription colorAttachmentDescription;
+    colorAttachmentDescription.flags = 0;
+    colorAttachmentDescription.format = format;
+    colorAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkSubpassDescription subpassDescription;
+    subpassDescription.flags = 0;
+    subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpassDescription.inputAttachmentCount = 0;
+    subpassDescription.pInputAttachments = nullptr;
+    subpassDescription.colorAttachmentCount = 1;
+    subpassDescription.pColorAttachments = &colorAttachment;
+    subpassDescription.pResolveAttachments = nullptr;
+    subpassDescription.pDepthStencilAttachment = nullptr;
+    subpassDescription.preserveAttachmentCount = 0;
+    subpassDescription.pPreserveAttachments = nullptr;
+
+    // Previous blit has to finish reading before the image is cleared again
+    VkSubpassDependency subpassBeginDependency;
+    subpassBeginDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpassBeginDependency.dstSubpass = 0;
+    subpassBeginDependency.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    subpassBeginDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassBeginDependency.srcAccessMask = 0;
+    subpassBeginDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpassBeginDependency.dependencyFlags = 0;
+    VkSubpassDependency subpassEndDependency;
+    subpassEndDependency.srcSubpass = 0;
+    subpassEndDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    subpassEndDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassEndDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    subpassEndDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpassEndDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    subpassEndDependency.dependencyFlags = 0;
+    VkSubpassDependency dependencies[] = {subpassBeginDependency, subpassEndDependency};
+
+    VkRenderPassCreateInfo renderPassInfo;
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.pNext = nullptr;
+    renderPassInfo.flags = 0;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachmentDescription;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpassDescription;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+    VkResult result = vkCreateRenderPass(device, &renderPassInfo, allocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS), &renderPass);
+    CHECK_SUCCEEDED(result, "failed to create offscreen render pass");
+}
+
+void DynamicResolution::createFramebuffer()
+{
+    VkFramebufferCreateInfo framebufferInfo;
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.pNext = nullptr;
+    framebufferInfo.flags = 0;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &imageView;
+    framebufferInfo.width = width;
+    framebufferInfo.height = height;
+    framebufferInfo.layers = 1;
+    VkResult result = vkCreateFramebuffer(device, &framebufferInfo, allocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &framebuffer);
+    CHECK_SUCCEEDED(result, "failed to create offscreen framebuffer");
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "allocator.h"
+
+// Renders into an offscreen target at a fraction of the output resolution
+// and blits it up to the swapchain images. The scale is driven by measured
+// GPU frame time, so that frame time holds at a target while quality stays
+// within [minScale, maxScale]. With dynamic rendering there is no render
+// pass or framebuffer, the caller renders to the image view and leaves the
+// image in TRANSFER_SRC_OPTIMAL layout for recordUpscale().
+class DynamicResolution
+{
+public:
+    DynamicResolution(VkPhysicalDevice physicalDevice, VkDevice device, HostAllocator& allocator,
+        VkFormat format, uint32_t width, uint32_t height,
+        float targetFrameTime, float minScale, float maxScale, bool dynamicRendering);
+    ~DynamicResolution();
+    static bool supported(VkPhysicalDevice physicalDevice, VkFormat format);
+    void update(float gpuFrameTime);
+    void recordUpscale(VkCommandBuffer cmdBuffer, VkImage dstImage, VkExtent2D dstExtent) const;
+    VkRenderPass getRenderPass() const { return renderPass; }
+    VkFramebuffer getFramebuffer() const { return framebuffer; }
+    VkImage getImage() const { return image; }
+    VkImageView getImageView() const { return imageView; }
+    VkExtent2D getRenderExtent() const;
+    float getScale() const { return scale; }
+
+private:
+    static constexpr float smoothing = 0.1f; // Weight of the latest frame in the moving average
+    static constexpr float deadband = 0.05f; // Relative frame time error that is tolerated
+    static constexpr float maxStep = 0.05f; // Per frame
+
+    uint32_t chooseMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const;
+    void createImage(VkFormat format);
+    void createRenderPass(VkFormat format);
+    void createFramebuffer();
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    HostAllocator& allocator;
+    const uint32_t width, height;
+    const float targetFrameTime; // Milliseconds
+    const float minScale, maxScale;
+
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    float scale;
+    float averageFrameTime = 0.f;
+};
@@ -0,0 +1,1259 @@
+// Null Vulkan driver. Implements the entry points used by the sample with
+// deterministic no-op execution, so that CPU-side frame cost can be
+// measured without a GPU, and the frame loop can run on GPU-less machines.
+// To use, point the loader at the manifest:
+//     set VK_ICD_FILENAMES=<path>\mockIcd.json
+// Latency (in microseconds) can be injected with environment variables
+// MOCK_ICD_ACQUIRE_LATENCY, MOCK_ICD_SUBMIT_LATENCY and MOCK_ICD_PRESENT_LATENCY.
+#define VK_NO_PROTOTYPES
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+#include <windows.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_icd.h>
+
+#define MOCK_ICD_INTERFACE_VERSION 5
+#define MOCK_API_VERSION VK_API_VERSION_1_1
+#define MOCK_QUEUE_COUNT 4
+#define MOCK_HEAP_SIZE (4ull * 1024 * 1024 * 1024)
+#define MOCK_SPARSE_BLOCK_SIZE 65536
+#define MOCK_SPARSE_TILE_SIZE 128
+#define MOCK_BUFFER_ALIGNMENT 256
+#define MOCK_PIPELINE_COMPILE_TIME 2 // Milliseconds per pipeline
+
+typedef std::chrono::steady_clock Clock;
+
+struct Latency
+{
+    std::chrono::nanoseconds acquire;
+    std::chrono::nanoseconds submit;
+    std::chrono::nanoseconds present;
+};
+
+static Latency latency;
+
+struct PhysicalDevice
+{
+    VK_LOADER_DATA loaderData;
+};
+
+struct Instance
+{
+    VK_LOADER_DATA loaderData;
+    PhysicalDevice physicalDevice;
+};
+
+struct Queue
+{
+    VK_LOADER_DATA loaderData;
+};
+
+struct Device
+{
+    VK_LOADER_DATA loaderData;
+    Queue queues[MOCK_QUEUE_COUNT];
+};
+
+struct QueryPool
+{
+    VkQueryType queryType;
+    uint32_t valueCount;
+    std::vector<uint64_t> values;
+};
+
+struct Memory
+{
+    VkDeviceSize size;
+    std::vector<uint8_t> data; // Allocated on first host access
+
+    uint8_t *host()
+    {
+        if (data.empty())
+            data.resize((size_t)size);
+        return data.data();
+    }
+};
+
+struct Buffer
+{
+    VkDeviceSize size;
+    Memory *memory;
+    VkDeviceSize memoryOffset;
+};
+
+struct Image
+{
+    VkExtent3D extent;
+    uint32_t mipLevels;
+    VkImageCreateFlags flags;
+};
+
+struct Command
+{   // Commands with side effects visible to the application
+    enum Type { WriteTimestamp, FillBuffer } type;
+    QueryPool *queryPool;
+    uint32_t query;
+    Buffer *buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t data;
+};
+
+struct CommandPool
+{
+    VkAllocationCallbacks allocator;
+    bool hasAllocator;
+};
+
+struct CommandBuffer
+{
+    VK_LOADER_DATA loaderData;
+    std::vector<Command> commands;
+};
+
+struct Fence
+{
+    std::atomic<bool> signaled;
+};
+
+struct Swapchain
+{
+    std::vector<VkImage> images;
+    uint32_t nextImage;
+};
+
+struct Object
+{   // Any object without state
+    uint64_t id;
+};
+
+template<class Handle, class Type>
+static Handle toHandle(Type *object)
+{
+    return (Handle)(uintptr_t)object;
+}
+
+template<class Type, class Handle>
+static Type *fromHandle(Handle handle)
+{
+    return (Type *)(uintptr_t)handle;
+}
+
+template<class Type>
+static Type *create(const VkAllocationCallbacks *allocator, VkSystemAllocationScope scope)
+{
+    void *memory = allocator ?
+        allocator->pfnAllocation(allocator->pUserData, sizeof(Type), alignof(Type), scope) :
+        ::operator new(sizeof(Type), std::nothrow);
+    return memory ? new(memory) Type() : nullptr;
+}
+
+template<class Type>
+static void destroy(Type *object, const VkAllocationCallbacks *allocator)
+{
+    if (!object)
+        return;
+    object->~Type();
+    if (allocator)
+        allocator->pfnFree(allocator->pUserData, object);
+    else
+        ::operator delete(object);
+}
+
+template<class Type>
+static VkResult enumerate(const Type *items, uint32_t itemCount, uint32_t *pCount, Type *pItems)
+{
+    if (!pItems)
+    {
+        *pCount = itemCount;
+        return VK_SUCCESS;
+    }
+    const uint32_t count = std::min(*pCount, itemCount);
+    std::copy(items, items + count, pItems);
+    *pCount = count;
+    return (count < itemCount) ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+static VkExtensionProperties extensionProperties(const char *extensionName, uint32_t specVersion)
+{
+    VkExtensionProperties properties = {};
+    strncpy_s(properties.extensionName, extensionName, _TRUNCATE);
+    properties.specVersion = specVersion;
+    return properties;
+}
+
+static std::chrono::nanoseconds readLatency(const char *variableName)
+{
+    char value[32];
+    const DWORD length = GetEnvironmentVariableA(variableName, value, sizeof(value));
+    if (!length || length >= sizeof(value))
+        return std::chrono::nanoseconds(0);
+    return std::chrono::microseconds(strtoul(value, nullptr, 10));
+}
+
+static void spin(std::chrono::nanoseconds duration)
+{   // Busy wait, Sleep() is too coarse for sub-millisecond latency
+    if (duration.count())
+    {
+        const Clock::time_point end = Clock::now() + duration;
+        while (Clock::now() < end);
+    }
+}
+
+static uint64_t timestamp()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void execute(uint32_t cmdBufferCount, const VkCommandBuffer *cmdBuffers)
+{
+    const uint64_t now = timestamp();
+    for (uint32_t i = 0; i < cmdBufferCount; ++i)
+    {
+        for (auto const& command: fromHandle<CommandBuffer>(cmdBuffers[i])->commands)
+        {
+            switch (command.type)
+            {
+            case Command::WriteTimestamp:
+                command.queryPool->values[command.query] = now;
+                break;
+            case Command::FillBuffer:
+                if (command.buffer->memory)
+                {
+                    uint32_t *data = (uint32_t *)(command.buffer->memory->host() + command.buffer->memoryOffset + command.offset);
+                    std::fill(data, data + command.size / sizeof(uint32_t), command.data);
+                }
+                break;
+            }
+        }
+    }
+}
+
+static void signal(VkFence fence)
+{
+    if (fence != VK_NULL_HANDLE)
+        fromHandle<Fence>(fence)->signaled = true;
+}
+
+// Instance
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(const VkInstanceCreateInfo *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkInstance *pInstance)
+{
+    latency.acquire = readLatency("MOCK_ICD_ACQUIRE_LATENCY");
+    latency.submit = readLatency("MOCK_ICD_SUBMIT_LATENCY");
+    latency.present = readLatency("MOCK_ICD_PRESENT_LATENCY");
+    Instance *instance = create<Instance>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+    if (!instance)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    set_loader_magic_value(instance);
+    set_loader_magic_value(&instance->physicalDevice);
+    *pInstance = (VkInstance)instance;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyInstance(VkInstance instance, const VkAllocationCallbacks *pAllocator)
+{
+    destroy((Instance *)instance, pAllocator);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumerateInstanceExtensionProperties(const char *pLayerName,
+    uint32_t *pPropertyCount, VkExtensionProperties *pProperties)
+{
+    const VkExtensionProperties properties[] = {
+        extensionProperties(VK_KHR_SURFACE_EXTENSION_NAME, 25),
+        extensionProperties(VK_KHR_WIN32_SURFACE_EXTENSION_NAME, 6),
+        extensionProperties(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, 2)
+    };
+    return enumerate(properties, (uint32_t)_countof(properties), pPropertyCount, pProperties);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumerateInstanceVersion(uint32_t *pApiVersion)
+{
+    *pApiVersion = MOCK_API_VERSION;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumeratePhysicalDevices(VkInstance instance,
+    uint32_t *pPhysicalDeviceCount, VkPhysicalDevice *pPhysicalDevices)
+{
+    const VkPhysicalDevice physicalDevice = (VkPhysicalDevice)&((Instance *)instance)->physicalDevice;
+    return enumerate(&physicalDevice, 1, pPhysicalDeviceCount, pPhysicalDevices);
+}
+
+// Physical device
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceProperties *pProperties)
+{
+    memset(pProperties, 0, sizeof(VkPhysicalDeviceProperties));
+    pProperties->apiVersion = MOCK_API_VERSION;
+    pProperties->driverVersion = 1;
+    pProperties->vendorID = 0xFFFF;
+    pProperties->deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+    strncpy_s(pProperties->deviceName, "Mock ICD", _TRUNCATE);
+    VkPhysicalDeviceLimits& limits = pProperties->limits;
+    limits.maxImageDimension1D = 16384;
+    limits.maxImageDimension2D = 16384;
+    limits.maxImageDimension3D = 2048;
+    limits.maxImageDimensionCube = 16384;
+    limits.maxImageArrayLayers = 2048;
+    limits.maxUniformBufferRange = 65536;
+    limits.maxStorageBufferRange = 0xFFFFFFFF;
+    limits.maxPushConstantsSize = 256;
+    limits.maxMemoryAllocationCount = 4096;
+    limits.maxSamplerAllocationCount = 4000;
+    limits.bufferImageGranularity = 1024;
+    limits.maxBoundDescriptorSets = 8;
+    limits.maxDescriptorSetUniformBuffersDynamic = 8;
+    limits.maxComputeWorkGroupInvocations = 1024;
+    limits.maxViewports = 16;
+    limits.maxViewportDimensions[0] = 16384;
+    limits.maxViewportDimensions[1] = 16384;
+    limits.minMemoryMapAlignment = 64;
+    limits.minTexelBufferOffsetAlignment = 16;
+    limits.minUniformBufferOffsetAlignment = 256;
+    limits.minStorageBufferOffsetAlignment = 16;
+    limits.maxFramebufferWidth = 16384;
+    limits.maxFramebufferHeight = 16384;
+    limits.maxFramebufferLayers = 2048;
+    limits.maxColorAttachments = 8;
+    limits.timestampComputeAndGraphics = VK_TRUE;
+    limits.timestampPeriod = 1.f;
+    limits.optimalBufferCopyOffsetAlignment = 16;
+    limits.optimalBufferCopyRowPitchAlignment = 16;
+    limits.nonCoherentAtomSize = 64;
+    limits.sparseAddressSpaceSize = 1ull << 40;
+    pProperties->sparseProperties.residencyStandard2DBlockShape = VK_TRUE;
+    pProperties->sparseProperties.residencyNonResidentStrict = VK_TRUE;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceProperties2(VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceProperties2 *pProperties)
+{
+    GetPhysicalDeviceProperties(physicalDevice, &pProperties->properties);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFeatures(VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceFeatures *pFeatures)
+{
+    memset(pFeatures, 0, sizeof(VkPhysicalDeviceFeatures));
+    pFeatures->pipelineStatisticsQuery = VK_TRUE;
+    pFeatures->sparseBinding = VK_TRUE;
+    pFeatures->sparseResidencyImage2D = VK_TRUE;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFeatures2(VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceFeatures2 *pFeatures)
+{
+    GetPhysicalDeviceFeatures(physicalDevice, &pFeatures->features);
+    for (VkBaseOutStructure *next = (VkBaseOutStructure *)pFeatures->pNext; next; next = next->pNext)
+    {
+        switch (next->sType)
+        {
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR:
+            ((VkPhysicalDeviceSynchronization2FeaturesKHR *)next)->synchronization2 = VK_TRUE;
+            break;
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR:
+            ((VkPhysicalDeviceDynamicRenderingFeaturesKHR *)next)->dynamicRendering = VK_TRUE;
+            break;
+        }
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice physicalDevice,
+    uint32_t *pQueueFamilyPropertyCount, VkQueueFamilyProperties *pQueueFamilyProperties)
+{
+    VkQueueFamilyProperties properties;
+    properties.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT;
+    properties.queueCount = MOCK_QUEUE_COUNT;
+    properties.timestampValidBits = 64;
+    properties.minImageTransferGranularity = VkExtent3D{1, 1, 1};
+    enumerate(&properties, 1, pQueueFamilyPropertyCount, pQueueFamilyProperties);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties *pMemoryProperties)
+{
+    memset(pMemoryProperties, 0, sizeof(VkPhysicalDeviceMemoryProperties));
+    pMemoryProperties->memoryTypeCount = 1;
+    pMemoryProperties->memoryTypes[0].propertyFlags =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    pMemoryProperties->memoryTypes[0].heapIndex = 0;
+    pMemoryProperties->memoryHeapCount = 1;
+    pMemoryProperties->memoryHeaps[0].size = MOCK_HEAP_SIZE;
+    pMemoryProperties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceFormatProperties(VkPhysicalDevice physicalDevice,
+    VkFormat format, VkFormatProperties *pFormatProperties)
+{   // Any format can be used for anything
+    pFormatProperties->linearTilingFeatures = ~0u;
+    pFormatProperties->optimalTilingFeatures = ~0u;
+    pFormatProperties->bufferFeatures = ~0u;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetPhysicalDeviceSparseImageFormatProperties(VkPhysicalDevice physicalDevice,
+    VkFormat format, VkImageType type, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageTiling tiling,
+    uint32_t *pPropertyCount, VkSparseImageFormatProperties *pProperties)
+{   // Standard block shape of 32-bit texels
+    VkSparseImageFormatProperties properties;
+    properties.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    properties.imageGranularity = VkExtent3D{MOCK_SPARSE_TILE_SIZE, MOCK_SPARSE_TILE_SIZE, 1};
+    properties.flags = VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT;
+    const bool supported = (VK_IMAGE_TYPE_2D == type) && (VK_SAMPLE_COUNT_1_BIT == samples) && (VK_IMAGE_TILING_OPTIMAL == tiling);
+    enumerate(&properties, supported ? 1 : 0, pPropertyCount, pProperties);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EnumerateDeviceExtensionProperties(VkPhysicalDevice physicalDevice,
+    const char *pLayerName, uint32_t *pPropertyCount, VkExtensionProperties *pProperties)
+{
+    const VkExtensionProperties properties[] = {
+        extensionProperties(VK_KHR_SWAPCHAIN_EXTENSION_NAME, 70),
+        extensionProperties(VK_KHR_MAINTENANCE1_EXTENSION_NAME, 2),
+        extensionProperties(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME, 1),
+        extensionProperties(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, 1),
+        extensionProperties(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME, 1),
+        extensionProperties(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, 1),
+        extensionProperties(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME, 2)
+    };
+    return enumerate(properties, (uint32_t)_countof(properties), pPropertyCount, pProperties);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceCalibrateableTimeDomainsEXT(VkPhysicalDevice physicalDevice,
+    uint32_t *pTimeDomainCount, VkTimeDomainEXT *pTimeDomains)
+{
+    const VkTimeDomainEXT timeDomains[] = {
+        VK_TIME_DOMAIN_DEVICE_EXT,
+        VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT
+    };
+    return enumerate(timeDomains, (uint32_t)_countof(timeDomains), pTimeDomainCount, pTimeDomains);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice physicalDevice,
+    uint32_t queueFamilyIndex, VkSurfaceKHR surface, VkBool32 *pSupported)
+{
+    *pSupported = VK_TRUE;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice physicalDevice,
+    VkSurfaceKHR surface, VkSurfaceCapabilitiesKHR *pSurfaceCapabilities)
+{
+    pSurfaceCapabilities->minImageCount = 2;
+    pSurfaceCapabilities->maxImageCount = 3;
+    pSurfaceCapabilities->currentExtent = VkExtent2D{0xFFFFFFFF, 0xFFFFFFFF};
+    pSurfaceCapabilities->minImageExtent = VkExtent2D{1, 1};
+    pSurfaceCapabilities->maxImageExtent = VkExtent2D{16384, 16384};
+    pSurfaceCapabilities->maxImageArrayLayers = 1;
+    pSurfaceCapabilities->supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    pSurfaceCapabilities->currentTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    pSurfaceCapabilities->supportedCompositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    pSurfaceCapabilities->supportedUsageFlags =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+        VK_IMAGE_USAGE_STORAGE_BIT;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice physicalDevice,
+    VkSurfaceKHR surface, uint32_t *pSurfaceFormatCount, VkSurfaceFormatKHR *pSurfaceFormats)
+{
+    const VkSurfaceFormatKHR surfaceFormat = {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    return enumerate(&surfaceFormat, 1, pSurfaceFormatCount, pSurfaceFormats);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetPhysicalDeviceSurfacePresentModesKHR(VkPhysicalDevice physicalDevice,
+    VkSurfaceKHR surface, uint32_t *pPresentModeCount, VkPresentModeKHR *pPresentModes)
+{
+    const VkPresentModeKHR presentModes[] = {
+        VK_PRESENT_MODE_IMMEDIATE_KHR,
+        VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_FIFO_KHR
+    };
+    return enumerate(presentModes, (uint32_t)_countof(presentModes), pPresentModeCount, pPresentModes);
+}
+
+// Device
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkDevice *pDevice)
+{
+    Device *device = create<Device>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+    if (!device)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    set_loader_magic_value(device);
+    for (Queue& queue: device->queues)
+        set_loader_magic_value(&queue);
+    *pDevice = (VkDevice)device;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyDevice(VkDevice device, const VkAllocationCallbacks *pAllocator)
+{
+    destroy((Device *)device, pAllocator);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetDeviceQueue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex, VkQueue *pQueue)
+{
+    *pQueue = (VkQueue)&((Device *)device)->queues[queueIndex % MOCK_QUEUE_COUNT];
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL DeviceWaitIdle(VkDevice device)
+{
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL QueueWaitIdle(VkQueue queue)
+{
+    return VK_SUCCESS;
+}
+
+// Swapchain
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkSwapchainKHR *pSwapchain)
+{
+    Swapchain *swapchain = create<Swapchain>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!swapchain)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    const uint32_t imageCount = std::max(pCreateInfo->minImageCount, 2u);
+    for (uint32_t i = 0; i < imageCount; ++i)
+    {
+        Object *image = create<Object>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+        swapchain->images.push_back(toHandle<VkImage>(image));
+    }
+    swapchain->nextImage = 0;
+    *pSwapchain = toHandle<VkSwapchainKHR>(swapchain);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks *pAllocator)
+{
+    Swapchain *object = fromHandle<Swapchain>(swapchain);
+    if (!object)
+        return;
+    for (VkImage image: object->images)
+        destroy(fromHandle<Object>(image), pAllocator);
+    destroy(object, pAllocator);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain,
+    uint32_t *pSwapchainImageCount, VkImage *pSwapchainImages)
+{
+    const Swapchain *object = fromHandle<Swapchain>(swapchain);
+    return enumerate(object->images.data(), (uint32_t)object->images.size(), pSwapchainImageCount, pSwapchainImages);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL AcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapchain, uint64_t timeout,
+    VkSemaphore semaphore, VkFence fence, uint32_t *pImageIndex)
+{
+    spin(latency.acquire);
+    Swapchain *object = fromHandle<Swapchain>(swapchain);
+    *pImageIndex = object->nextImage;
+    object->nextImage = (object->nextImage + 1) % (uint32_t)object->images.size();
+    signal(fence);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
+{
+    spin(latency.present);
+    if (pPresentInfo->pResults)
+        std::fill(pPresentInfo->pResults, pPresentInfo->pResults + pPresentInfo->swapchainCount, VK_SUCCESS);
+    return VK_SUCCESS;
+}
+
+// Queue submission
+
+static VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *pSubmits, VkFence fence)
+{
+    spin(latency.submit);
+    for (uint32_t i = 0; i < submitCount; ++i)
+        execute(pSubmits[i].commandBufferCount, pSubmits[i].pCommandBuffers);
+    signal(fence);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit2KHR(VkQueue queue, uint32_t submitCount, const VkSubmitInfo2KHR *pSubmits, VkFence fence)
+{
+    spin(latency.submit);
+    for (uint32_t i = 0; i < submitCount; ++i)
+    {
+        for (uint32_t j = 0; j < pSubmits[i].commandBufferInfoCount; ++j)
+            execute(1, &pSubmits[i].pCommandBufferInfos[j].commandBuffer);
+    }
+    signal(fence);
+    return VK_SUCCESS;
+}
+
+// Synchronization
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateFence(VkDevice device, const VkFenceCreateInfo *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkFence *pFence)
+{
+    Fence *fence = create<Fence>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!fence)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    fence->signaled = (pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT) != 0;
+    *pFence = toHandle<VkFence>(fence);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyFence(VkDevice device, VkFence fence, const VkAllocationCallbacks *pAllocator)
+{
+    destroy(fromHandle<Fence>(fence), pAllocator);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL ResetFences(VkDevice device, uint32_t fenceCount, const VkFence *pFences)
+{
+    for (uint32_t i = 0; i < fenceCount; ++i)
+        fromHandle<Fence>(pFences[i])->signaled = false;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetFenceStatus(VkDevice device, VkFence fence)
+{
+    return fromHandle<Fence>(fence)->signaled ? VK_SUCCESS : VK_NOT_READY;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL WaitForFences(VkDevice device, uint32_t fenceCount, const VkFence *pFences,
+    VkBool32 waitAll, uint64_t timeout)
+{   // Fences may be signaled by a submission from another thread
+    const uint64_t maxTimeout = 24ull * 3600 * 1000000000;
+    const Clock::time_point deadline = Clock::now() + std::chrono::nanoseconds(std::min(timeout, maxTimeout));
+    for (;;)
+    {
+        uint32_t signaledCount = 0;
+        for (uint32_t i = 0; i < fenceCount; ++i)
+        {
+            if (fromHandle<Fence>(pFences[i])->signaled)
+                ++signaledCount;
+        }
+        if ((signaledCount == fenceCount) || (!waitAll && signaledCount))
+            return VK_SUCCESS;
+        if (Clock::now() >= deadline)
+            return VK_TIMEOUT;
+        std::this_thread::yield();
+    }
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkSemaphore *pSemaphore)
+{
+    Object *semaphore = create<Object>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!semaphore)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    *pSemaphore = toHandle<VkSemaphore>(semaphore);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroySemaphore(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks *pAllocator)
+{
+    destroy(fromHandle<Object>(semaphore), pAllocator);
+}
+
+// Stateless objects
+
+#define STATELESS_OBJECT(Type, CreateInfo)\
+static VKAPI_ATTR VkResult VKAPI_CALL Create##Type(VkDevice device, const CreateInfo *pCreateInfo,\
+    const VkAllocationCallbacks *pAllocator, Vk##Type *pObject)\
+{\
+    Object *object = create<Object>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\
+    if (!object)\
+        return VK_ERROR_OUT_OF_HOST_MEMORY;\
+    *pObject = toHandle<Vk##Type>(object);\
+    return VK_SUCCESS;\
+}\
+static VKAPI_ATTR void VKAPI_CALL Destroy##Type(VkDevice device, Vk##Type object, const VkAllocationCallbacks *pAllocator)\
+{\
+    destroy(fromHandle<Object>(object), pAllocator);\
+}
+
+STATELESS_OBJECT(ImageView, VkImageViewCreateInfo)
+STATELESS_OBJECT(RenderPass, VkRenderPassCreateInfo)
+STATELESS_OBJECT(Framebuffer, VkFramebufferCreateInfo)
+STATELESS_OBJECT(DescriptorSetLayout, VkDescriptorSetLayoutCreateInfo)
+STATELESS_OBJECT(DescriptorPool, VkDescriptorPoolCreateInfo)
+STATELESS_OBJECT(PipelineLayout, VkPipelineLayoutCreateInfo)
+STATELESS_OBJECT(PipelineCache, VkPipelineCacheCreateInfo)
+STATELESS_OBJECT(ShaderModule, VkShaderModuleCreateInfo)
+
+template<class CreateInfo>
+static VkResult createPipelines(uint32_t createInfoCount, const CreateInfo *pCreateInfos,
+    const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines)
+{   // Compilation takes time, so that asynchronous compilation can be observed
+    for (uint32_t i = 0; i < createInfoCount; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(MOCK_PIPELINE_COMPILE_TIME));
+        Object *pipeline = create<Object>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+        if (!pipeline)
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        pPipelines[i] = toHandle<VkPipeline>(pipeline);
+    }
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateGraphicsPipelines(VkDevice device, VkPipelineCache pipelineCache,
+    uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo *pCreateInfos,
+    const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines)
+{
+    return createPipelines(createInfoCount, pCreateInfos, pAllocator, pPipelines);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateComputePipelines(VkDevice device, VkPipelineCache pipelineCache,
+    uint32_t createInfoCount, const VkComputePipelineCreateInfo *pCreateInfos,
+    const VkAllocationCallbacks *pAllocator, VkPipeline *pPipelines)
+{
+    return createPipelines(createInfoCount, pCreateInfos, pAllocator, pPipelines);
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks *pAllocator)
+{
+    destroy(fromHandle<Object>(pipeline), pAllocator);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL AllocateDescriptorSets(VkDevice device,
+    const VkDescriptorSetAllocateInfo *pAllocateInfo, VkDescriptorSet *pDescriptorSets)
+{   // Sets are never dereferenced, unique handles are enough
+    static std::atomic<uint64_t> nextSet(1);
+    for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i)
+        pDescriptorSets[i] = toHandle<VkDescriptorSet>((Object *)(uintptr_t)(nextSet++ << 4));
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL UpdateDescriptorSets(VkDevice device,
+    uint32_t descriptorWriteCount, const VkWriteDescriptorSet *pDescriptorWrites,
+    uint32_t descriptorCopyCount, const VkCopyDescriptorSet *pDescriptorCopies)
+{}
+
+// Memory and resources
+
+static VkDeviceSize alignUp(VkDeviceSize size, VkDeviceSize alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL AllocateMemory(VkDevice device, const VkMemoryAllocateInfo *pAllocateInfo,
+    const VkAllocationCallbacks *pAllocator, VkDeviceMemory *pMemory)
+{
+    Memory *memory = create<Memory>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!memory)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    memory->size = pAllocateInfo->allocationSize;
+    *pMemory = toHandle<VkDeviceMemory>(memory);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL FreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks *pAllocator)
+{
+    destroy(fromHandle<Memory>(memory), pAllocator);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL MapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset,
+    VkDeviceSize size, VkMemoryMapFlags flags, void **ppData)
+{
+    *ppData = fromHandle<Memory>(memory)->host() + offset;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL UnmapMemory(VkDevice device, VkDeviceMemory memory)
+{}
+
+static VKAPI_ATTR VkResult VKAPI_CALL FlushMappedMemoryRanges(VkDevice device, uint32_t memoryRangeCount,
+    const VkMappedMemoryRange *pMemoryRanges)
+{
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateBuffer(VkDevice device, const VkBufferCreateInfo *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkBuffer *pBuffer)
+{
+    Buffer *buffer = create<Buffer>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!buffer)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    buffer->size = pCreateInfo->size;
+    buffer->memory = nullptr;
+    buffer->memoryOffset = 0;
+    *pBuffer = toHandle<VkBuffer>(buffer);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks *pAllocator)
+{
+    destroy(fromHandle<Buffer>(buffer), pAllocator);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetBufferMemoryRequirements(VkDevice device, VkBuffer buffer,
+    VkMemoryRequirements *pMemoryRequirements)
+{
+    pMemoryRequirements->size = alignUp(fromHandle<Buffer>(buffer)->size, MOCK_BUFFER_ALIGNMENT);
+    pMemoryRequirements->alignment = MOCK_BUFFER_ALIGNMENT;
+    pMemoryRequirements->memoryTypeBits = 1;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL BindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory,
+    VkDeviceSize memoryOffset)
+{
+    Buffer *object = fromHandle<Buffer>(buffer);
+    object->memory = fromHandle<Memory>(memory);
+    object->memoryOffset = memoryOffset;
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateImage(VkDevice device, const VkImageCreateInfo *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkImage *pImage)
+{
+    Image *image = create<Image>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!image)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    image->extent = pCreateInfo->extent;
+    image->mipLevels = pCreateInfo->mipLevels;
+    image->flags = pCreateInfo->flags;
+    *pImage = toHandle<VkImage>(image);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks *pAllocator)
+{
+    destroy(fromHandle<Image>(image), pAllocator);
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetImageMemoryRequirements(VkDevice device, VkImage image,
+    VkMemoryRequirements *pMemoryRequirements)
+{   // Assumes 32-bit texels
+    const Image *object = fromHandle<Image>(image);
+    VkDeviceSize size = 0;
+    for (uint32_t mipLevel = 0; mipLevel < object->mipLevels; ++mipLevel)
+    {
+        size += (VkDeviceSize)std::max(object->extent.width >> mipLevel, 1u) *
+            std::max(object->extent.height >> mipLevel, 1u) * sizeof(uint32_t);
+    }
+    pMemoryRequirements->alignment = (object->flags & VK_IMAGE_CREATE_SPARSE_BINDING_BIT) ?
+        MOCK_SPARSE_BLOCK_SIZE : MOCK_BUFFER_ALIGNMENT;
+    pMemoryRequirements->size = alignUp(size, pMemoryRequirements->alignment);
+    pMemoryRequirements->memoryTypeBits = 1;
+}
+
+static VKAPI_ATTR void VKAPI_CALL GetImageSparseMemoryRequirements(VkDevice device, VkImage image,
+    uint32_t *pSparseMemoryRequirementCount, VkSparseImageMemoryRequirements *pSparseMemoryRequirements)
+{
+    const Image *object = fromHandle<Image>(image);
+    VkSparseImageMemoryRequirements requirements;
+    requirements.formatProperties.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    requirements.formatProperties.imageGranularity = VkExtent3D{MOCK_SPARSE_TILE_SIZE, MOCK_SPARSE_TILE_SIZE, 1};
+    requirements.formatProperties.flags = VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT;
+    requirements.imageMipTailFirstLod = 0;
+    while ((requirements.imageMipTailFirstLod < object->mipLevels) &&
+        ((object->extent.width >> requirements.imageMipTailFirstLod) >= MOCK_SPARSE_TILE_SIZE) &&
+        ((object->extent.height >> requirements.imageMipTailFirstLod) >= MOCK_SPARSE_TILE_SIZE))
+    {
+        ++requirements.imageMipTailFirstLod;
+    }
+    requirements.imageMipTailSize = MOCK_SPARSE_BLOCK_SIZE;
+    requirements.imageMipTailOffset = 1ull << 32;
+    requirements.imageMipTailStride = 0;
+    enumerate(&requirements, 1, pSparseMemoryRequirementCount, pSparseMemoryRequirements);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL BindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory,
+    VkDeviceSize memoryOffset)
+{
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL QueueBindSparse(VkQueue queue, uint32_t bindInfoCount,
+    const VkBindSparseInfo *pBindInfo, VkFence fence)
+{
+    spin(latency.submit);
+    signal(fence);
+    return VK_SUCCESS;
+}
+
+// Query pools
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateQueryPool(VkDevice device, const VkQueryPoolCreateInfo *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkQueryPool *pQueryPool)
+{
+    QueryPool *queryPool = create<QueryPool>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!queryPool)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    queryPool->queryType = pCreateInfo->queryType;
+    queryPool->valueCount = 1;
+    if (VK_QUERY_TYPE_PIPELINE_STATISTICS == pCreateInfo->queryType)
+    {
+        queryPool->valueCount = 0;
+        for (VkFlags bits = pCreateInfo->pipelineStatistics; bits; bits &= bits - 1)
+            ++queryPool->valueCount;
+    }
+    queryPool->values.resize(pCreateInfo->queryCount * queryPool->valueCount, 0);
+    *pQueryPool = toHandle<VkQueryPool>(queryPool);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyQueryPool(VkDevice device, VkQueryPool queryPool, const VkAllocationCallbacks *pAllocator)
+{
+    destroy(fromHandle<QueryPool>(queryPool), pAllocator);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetQueryPoolResults(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery,
+    uint32_t queryCount, size_t dataSize, void *pData, VkDeviceSize stride, VkQueryResultFlags flags)
+{
+    const QueryPool *object = fromHandle<QueryPool>(queryPool);
+    char *data = (char *)pData;
+    for (uint32_t query = firstQuery; query < firstQuery + queryCount; ++query, data += stride)
+    {
+        for (uint32_t i = 0; i < object->valueCount; ++i)
+        {
+            const uint64_t value = object->values[query * object->valueCount + i];
+            if (flags & VK_QUERY_RESULT_64_BIT)
+                memcpy(data + i * sizeof(uint64_t), &value, sizeof(uint64_t));
+            else
+            {
+                const uint32_t value32 = (uint32_t)value;
+                memcpy(data + i * sizeof(uint32_t), &value32, sizeof(uint32_t));
+            }
+        }
+    }
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL GetCalibratedTimestampsEXT(VkDevice device, uint32_t timestampCount,
+    const VkCalibratedTimestampInfoEXT *pTimestampInfos, uint64_t *pTimestamps, uint64_t *pMaxDeviation)
+{
+    for (uint32_t i = 0; i < timestampCount; ++i)
+    {
+        if (VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT == pTimestampInfos[i].timeDomain)
+        {
+            LARGE_INTEGER counter;
+            QueryPerformanceCounter(&counter);
+            pTimestamps[i] = (uint64_t)counter.QuadPart;
+        }
+        else
+            pTimestamps[i] = timestamp();
+    }
+    *pMaxDeviation = 1;
+    return VK_SUCCESS;
+}
+
+// Command buffers
+
+static VKAPI_ATTR VkResult VKAPI_CALL CreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo *pCreateInfo,
+    const VkAllocationCallbacks *pAllocator, VkCommandPool *pCommandPool)
+{
+    CommandPool *cmdPool = create<CommandPool>(pAllocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    if (!cmdPool)
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    cmdPool->hasAllocator = (pAllocator != nullptr);
+    if (pAllocator)
+        cmdPool->allocator = *pAllocator;
+    *pCommandPool = toHandle<VkCommandPool>(cmdPool);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL DestroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks *pAllocator)
+{
+    destroy(fromHandle<CommandPool>(commandPool), pAllocator);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL ResetCommandPool(VkDevice device, VkCommandPool commandPool, VkCommandPoolResetFlags flags)
+{
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL AllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo *pAllocateInfo,
+    VkCommandBuffer *pCommandBuffers)
+{
+    const CommandPool *cmdPool = fromHandle<CommandPool>(pAllocateInfo->commandPool);
+    const VkAllocationCallbacks *allocator = cmdPool->hasAllocator ? &cmdPool->allocator : nullptr;
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; ++i)
+    {
+        CommandBuffer *cmdBuffer = create<CommandBuffer>(allocator, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+        if (!cmdBuffer)
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+        set_loader_magic_value(cmdBuffer);
+        pCommandBuffers[i] = (VkCommandBuffer)cmdBuffer;
+    }
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL FreeCommandBuffers(VkDevice device, VkCommandPool commandPool,
+    uint32_t commandBufferCount, const VkCommandBuffer *pCommandBuffers)
+{
+    const CommandPool *cmdPool = fromHandle<CommandPool>(commandPool);
+    const VkAllocationCallbacks *allocator = cmdPool->hasAllocator ? &cmdPool->allocator : nullptr;
+    for (uint32_t i = 0; i < commandBufferCount; ++i)
+        destroy((CommandBuffer *)pCommandBuffers[i], allocator);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL BeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo *pBeginInfo)
+{
+    ((CommandBuffer *)commandBuffer)->commands.clear();
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL EndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL ResetCommandBuffer(VkCommandBuffer commandBuffer, VkCommandBufferResetFlags flags)
+{
+    ((CommandBuffer *)commandBuffer)->commands.clear();
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(VkCommandBuffer commandBuffer,
+    const VkRenderPassBeginInfo *pRenderPassBegin, VkSubpassContents contents)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdEndRenderPass(VkCommandBuffer commandBuffer)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool,
+    uint32_t firstQuery, uint32_t queryCount)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits pipelineStage,
+    VkQueryPool queryPool, uint32_t query)
+{
+    Command command = {};
+    command.type = Command::WriteTimestamp;
+    command.queryPool = fromHandle<QueryPool>(queryPool);
+    command.query = query;
+    ((CommandBuffer *)commandBuffer)->commands.push_back(command);
+}
+
+static VKAPI_ATTR void VKAPI_CALL CmdBeginQuery(VkCommandBuffer commandBuffer, VkQueryPool queryPool,
+    uint32_t query, VkQueryControlFlags flags)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdEndQuery(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t query)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdPipelineBarrier(VkCommandBuffer commandBuffer,
+    VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+    uint32_t memoryBarrierCount, const VkMemoryBarrier *pMemoryBarriers,
+    uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+    uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer,
+    VkImage dstImage, VkImageLayout dstImageLayout, uint32_t regionCount, const VkBufferImageCopy *pRegions)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer,
+    VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy *pRegions)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdBlitImage(VkCommandBuffer commandBuffer,
+    VkImage srcImage, VkImageLayout srcImageLayout, VkImage dstImage, VkImageLayout dstImageLayout,
+    uint32_t regionCount, const VkImageBlit *pRegions, VkFilter filter)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdBindPipeline(VkCommandBuffer commandBuffer,
+    VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdSetViewport(VkCommandBuffer commandBuffer,
+    uint32_t firstViewport, uint32_t viewportCount, const VkViewport *pViewports)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdSetScissor(VkCommandBuffer commandBuffer,
+    uint32_t firstScissor, uint32_t scissorCount, const VkRect2D *pScissors)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdBindDescriptorSets(VkCommandBuffer commandBuffer,
+    VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout, uint32_t firstSet,
+    uint32_t descriptorSetCount, const VkDescriptorSet *pDescriptorSets,
+    uint32_t dynamicOffsetCount, const uint32_t *pDynamicOffsets)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdDraw(VkCommandBuffer commandBuffer,
+    uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdBeginRenderingKHR(VkCommandBuffer commandBuffer,
+    const VkRenderingInfoKHR *pRenderingInfo)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdEndRenderingKHR(VkCommandBuffer commandBuffer)
+{}
+
+static VKAPI_ATTR void VKAPI_CALL CmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer,
+    VkDeviceSize dstOffset, VkDeviceSize size, uint32_t data)
+{
+    Command command = {};
+    command.type = Command::FillBuffer;
+    command.buffer = fromHandle<Buffer>(dstBuffer);
+    command.offset = dstOffset;
+    command.size = (VK_WHOLE_SIZE == size) ? (command.buffer->size - dstOffset) & ~3ull : size;
+    command.data = data;
+    ((CommandBuffer *)commandBuffer)->commands.push_back(command);
+}
+
+// Entry points
+
+struct EntryPoint
+{
+    const char *name;
+    PFN_vkVoidFunction function;
+};
+
+#define ENTRY_POINT(name) {"vk" #name, (PFN_vkVoidFunction)name}
+#define ENTRY_POINT_ALIAS(alias, name) {"vk" #alias, (PFN_vkVoidFunction)name}
+
+static const EntryPoint entryPoints[] = {
+    ENTRY_POINT(CreateInstance),
+    ENTRY_POINT(DestroyInstance),
+    ENTRY_POINT(EnumerateInstanceExtensionProperties),
+    ENTRY_POINT(EnumerateInstanceVersion),
+    ENTRY_POINT(EnumeratePhysicalDevices),
+    ENTRY_POINT(GetPhysicalDeviceProperties),
+    ENTRY_POINT(GetPhysicalDeviceProperties2),
+    ENTRY_POINT_ALIAS(GetPhysicalDeviceProperties2KHR, GetPhysicalDeviceProperties2),
+    ENTRY_POINT(GetPhysicalDeviceFeatures),
+    ENTRY_POINT(GetPhysicalDeviceFeatures2),
+    ENTRY_POINT_ALIAS(GetPhysicalDeviceFeatures2KHR, GetPhysicalDeviceFeatures2),
+    ENTRY_POINT(GetPhysicalDeviceQueueFamilyProperties),
+    ENTRY_POINT(GetPhysicalDeviceMemoryProperties),
+    ENTRY_POINT(GetPhysicalDeviceFormatProperties),
+    ENTRY_POINT(GetPhysicalDeviceSparseImageFormatProperties),
+    ENTRY_POINT(EnumerateDeviceExtensionProperties),
+    ENTRY_POINT(GetPhysicalDeviceCalibrateableTimeDomainsEXT),
+    ENTRY_POINT(GetPhysicalDeviceSurfaceSupportKHR),
+    ENTRY_POINT(GetPhysicalDeviceSurfaceCapabilitiesKHR),
+    ENTRY_POINT(GetPhysicalDeviceSurfaceFormatsKHR),
+    ENTRY_POINT(GetPhysicalDeviceSurfacePresentModesKHR),
+    ENTRY_POINT(CreateDevice),
+    ENTRY_POINT(DestroyDevice),
+    ENTRY_POINT(GetDeviceQueue),
+    ENTRY_POINT(DeviceWaitIdle),
+    ENTRY_POINT(QueueWaitIdle),
+    ENTRY_POINT(CreateSwapchainKHR),
+    ENTRY_POINT(DestroySwapchainKHR),
+    ENTRY_POINT(GetSwapchainImagesKHR),
+    ENTRY_POINT(AcquireNextImageKHR),
+    ENTRY_POINT(QueuePresentKHR),
+    ENTRY_POINT(QueueSubmit),
+    ENTRY_POINT(QueueSubmit2KHR),
+    ENTRY_POINT(CreateFence),
+    ENTRY_POINT(DestroyFence),
+    ENTRY_POINT(ResetFences),
+    ENTRY_POINT(GetFenceStatus),
+    ENTRY_POINT(WaitForFences),
+    ENTRY_POINT(CreateSemaphore),
+    ENTRY_POINT(DestroySemaphore),
+    ENTRY_POINT(CreateImageView),
+    ENTRY_POINT(DestroyImageView),
+    ENTRY_POINT(CreateRenderPass),
+    ENTRY_POINT(DestroyRenderPass),
+    ENTRY_POINT(CreateFramebuffer),
+    ENTRY_POINT(DestroyFramebuffer),
+    ENTRY_POINT(CreateDescriptorSetLayout),
+    ENTRY_POINT(DestroyDescriptorSetLayout),
+    ENTRY_POINT(CreateDescriptorPool),
+    ENTRY_POINT(DestroyDescriptorPool),
+    ENTRY_POINT(AllocateDescriptorSets),
+    ENTRY_POINT(UpdateDescriptorSets),
+    ENTRY_POINT(CreatePipelineLayout),
+    ENTRY_POINT(DestroyPipelineLayout),
+    ENTRY_POINT(CreatePipelineCache),
+    ENTRY_POINT(DestroyPipelineCache),
+    ENTRY_POINT(CreateShaderModule),
+    ENTRY_POINT(DestroyShaderModule),
+    ENTRY_POINT(CreateGraphicsPipelines),
+    ENTRY_POINT(CreateComputePipelines),
+    ENTRY_POINT(DestroyPipeline),
+    ENTRY_POINT(AllocateMemory),
+    ENTRY_POINT(FreeMemory),
+    ENTRY_POINT(MapMemory),
+    ENTRY_POINT(UnmapMemory),
+    ENTRY_POINT(FlushMappedMemoryRanges),
+    ENTRY_POINT(CreateBuffer),
+    ENTRY_POINT(DestroyBuffer),
+    ENTRY_POINT(GetBufferMemoryRequirements),
+    ENTRY_POINT(BindBufferMemory),
+    ENTRY_POINT(CreateImage),
+    ENTRY_POINT(DestroyImage),
+    ENTRY_POINT(GetImageMemoryRequirements),
+    ENTRY_POINT(GetImageSparseMemoryRequirements),
+    ENTRY_POINT(BindImageMemory),
+    ENTRY_POINT(QueueBindSparse),
+    ENTRY_POINT(CreateQueryPool),
+    ENTRY_POINT(DestroyQueryPool),
+    ENTRY_POINT(GetQueryPoolResults),
+    ENTRY_POINT(GetCalibratedTimestampsEXT),
+    ENTRY_POINT(CreateCommandPool),
+    ENTRY_POINT(DestroyCommandPool),
+    ENTRY_POINT(ResetCommandPool),
+    ENTRY_POINT(AllocateCommandBuffers),
+    ENTRY_POINT(FreeCommandBuffers),
+    ENTRY_POINT(BeginCommandBuffer),
+    ENTRY_POINT(EndCommandBuffer),
+    ENTRY_POINT(ResetCommandBuffer),
+    ENTRY_POINT(CmdBeginRenderPass),
+    ENTRY_POINT(CmdEndRenderPass),
+    ENTRY_POINT(CmdResetQueryPool),
+    ENTRY_POINT(CmdWriteTimestamp),
+    ENTRY_POINT(CmdBeginQuery),
+    ENTRY_POINT(CmdEndQuery),
+    ENTRY_POINT(CmdPipelineBarrier),
+    ENTRY_POINT(CmdCopyBuffer),
+    ENTRY_POINT(CmdCopyBufferToImage),
+    ENTRY_POINT(CmdBlitImage),
+    ENTRY_POINT(CmdBindPipeline),
+    ENTRY_POINT(CmdSetViewport),
+    ENTRY_POINT(CmdSetScissor),
+    ENTRY_POINT(CmdBindDescriptorSets),
+    ENTRY_POINT(CmdDraw),
+    ENTRY_POINT(CmdBeginRenderingKHR),
+    ENTRY_POINT(CmdEndRenderingKHR),
+    ENTRY_POINT(CmdFillBuffer)
+};
+
+static PFN_vkVoidFunction findEntryPoint(const char *name)
+{
+    for (auto const& entryPoint: entryPoints)
+    {
+        if (!strcmp(entryPoint.name, name))
+            return entryPoint.function;
+    }
+    return nullptr;
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(VkDevice device, const char *pName)
+{
+    if (!strcmp(pName, "vkGetDeviceProcAddr"))
+        return (PFN_vkVoidFunction)GetDeviceProcAddr;
+    return findEntryPoint(pName);
+}
+
+extern "C" VKAPI_ATTR VkResult VKAPI_CALL vk_icdNegotiateLoaderICDInterfaceVersion(uint32_t *pSupportedVersion)
+{
+    *pSupportedVersion = std::min(*pSupportedVersion, (uint32_t)MOCK_ICD_INTERFACE_VERSION);
+    return VK_SUCCESS;
+}
+
+extern "C" VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vk_icdGetInstanceProcAddr(VkInstance instance, const char *pName)
+{
+    if (!strcmp(pName, "vkGetInstanceProcAddr"))
+        return (PFN_vkVoidFunction)vk_icdGetInstanceProcAddr;
+    if (!strcmp(pName, "vkGetDeviceProcAddr"))
+        return (PFN_vkVoidFunction)GetDeviceProcAddr;
+    return findEntryPoint(pName);
+}
+
+extern "C" VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vk_icdGetPhysicalDeviceProcAddr(VkInstance instance, const char *pName)
+{
+    return findEntryPoint(pName);
+}
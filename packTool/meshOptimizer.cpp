@@ -0,0 +1,600 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include "meshOptimizer.h"
+
+#define VERTEX_CACHE_SIZE 32 // LRU cache modelled by the optimizer
+#define FIFO_CACHE_SIZE 16 // FIFO cache used to measure ACMR
+#define OVERDRAW_THRESHOLD 1.05f // Tolerated ACMR loss of the overdraw pass
+#define OVERDRAW_MIN_CLUSTER 16 // Triangles
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+static const char *skipSpaces(const char *p)
+{
+    while ((' ' == *p) || ('\t' == *p))
+        ++p;
+    return p;
+}
+
+static const char *parseFloats(const char *p, float *values, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        char *end;
+        values[i] = strtof(p, &end);
+        p = end;
+    }
+    return p;
+}
+
+static int resolveIndex(long index, size_t count)
+{   // 1-based, negative is relative to the end
+    if (index > 0)
+        return (int)index - 1;
+    if (index < 0)
+        return (int)count + (int)index;
+    return -1;
+}
+
+bool loadObj(const char *fileName, Mesh& mesh)
+{
+    std::ifstream file(fileName);
+    if (!file)
+        return false;
+    std::vector<float> positions, normals, uvs;
+    std::unordered_map<uint64_t, uint32_t> vertexMap;
+    std::vector<bool> hasNormal;
+    std::vector<uint32_t> polygon;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const char *p = skipSpaces(line.c_str());
+        if (!strncmp(p, "v ", 2))
+        {
+            float position[3] = {0.f, 0.f, 0.f};
+            parseFloats(p + 2, position, 3);
+            positions.insert(positions.end(), position, position + 3);
+        }
+        else if (!strncmp(p, "vn ", 3))
+        {
+            float normal[3] = {0.f, 0.f, 1.f};
+            parseFloats(p + 3, normal, 3);
+            normals.insert(normals.end(), normal, normal + 3);
+        }
+        else if (!strncmp(p, "vt ", 3))
+        {
+            float uv[2] = {0.f, 0.f};
+            parseFloats(p + 3, uv, 2);
+            uvs.insert(uvs.end(), uv, uv + 2);
+        }
+        else if (!strncmp(p, "f ", 2))
+        {
+            polygon.clear();
+            p = skipSpaces(p + 2);
+            while (*p && (*p != '\r'))
+            {   // v, v/t, v//n or v/t/n
+                char *end;
+                const int v = resolveIndex(strtol(p, &end, 10), positions.size() / 3);
+                int t = -1, n = -1;
+                p = end;
+                if ('/' == *p)
+                {
+                    if (p[1] != '/')
+                        t = resolveIndex(strtol(p + 1, &end, 10), uvs.size() / 2);
+                    else
+                        end = (char *)p + 1;
+                    p = end;
+                    if ('/' == *p)
+                    {
+                        n = resolveIndex(strtol(p + 1, &end, 10), normals.size() / 3);
+                        p = end;
+                    }
+                }
+                if ((v < 0) || (v >= (int)(positions.size() / 3)) || (t >= (int)(uvs.size() / 2)) || (n >= (int)(normals.size() / 3)))
+                    return false;
+                if ((v >= (1 << 21)) || (t >= (1 << 21)) || (n >= (1 << 21)))
+                    return false; // Doesn't fit the vertex key
+                const uint64_t key = ((uint64_t)v << 42) | ((uint64_t)(t + 1) << 21) | (uint64_t)(n + 1);
+                auto it = vertexMap.find(key);
+                if (it == vertexMap.end())
+                {
+                    MeshVertex vertex = {};
+                    memcpy(vertex.position, &positions[v * 3], sizeof(vertex.position));
+                    if (n >= 0)
+                        memcpy(vertex.normal, &normals[n * 3], sizeof(vertex.normal));
+                    if (t >= 0)
+                    {   // OBJ has the origin of texture space at the bottom
+                        vertex.uv[0] = uvs[t * 2];
+                        vertex.uv[1] = 1.f - uvs[t * 2 + 1];
+                    }
+                    it = vertexMap.emplace(key, (uint32_t)mesh.vertices.size()).first;
+                    mesh.vertices.push_back(vertex);
+                    hasNormal.push_back(n >= 0);
+                }
+                polygon.push_back(it->second);
+                p = skipSpaces(p);
+            }
+            for (size_t i = 2; i < polygon.size(); ++i)
+            {   // Triangle fan
+                mesh.indices.push_back(polygon[0]);
+                mesh.indices.push_back(polygon[i - 1]);
+                mesh.indices.push_back(polygon[i]);
+            }
+        }
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {   // Vertices without normal get the area-weighted sum of face normals
+        const float *p0 = mesh.vertices[mesh.indices[i]].position;
+        const float *p1 = mesh.vertices[mesh.indices[i + 1]].position;
+        const float *p2 = mesh.vertices[mesh.indices[i + 2]].position;
+        const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        const float normal[3] = {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0]};
+        for (size_t j = i; j < i + 3; ++j)
+        {
+            if (!hasNormal[mesh.indices[j]])
+            {
+                for (int k = 0; k < 3; ++k)
+                    mesh.vertices[mesh.indices[j]].normal[k] += normal[k];
+            }
+        }
+    }
+    return !mesh.indices.empty();
+}
+
+float computeAcmr(const std::vector<uint32_t>& indices, uint32_t cacheSize)
+{
+    if (indices.empty())
+        return 0.f;
+    const uint32_t vertexCount = *std::max_element(indices.begin(), indices.end()) + 1;
+    // Vertex is in the FIFO if fewer than cacheSize vertices were inserted since it was
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    uint32_t misses = 0;
+    for (uint32_t index: indices)
+    {
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            ++misses;
+        }
+    }
+    return (float)misses / (indices.size() / 3);
+}
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles)
+{   // Forsyth, "Linear-Speed Vertex Cache Optimisation"
+    if (!remainingTriangles)
+        return -1.f;
+    float score = 0.f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+            score = 0.75f; // Used by the last triangle
+        else
+            score = std::pow(1.f - (cachePosition - 3) * (1.f / (VERTEX_CACHE_SIZE - 3)), 1.5f);
+    }
+    // Prefer vertices with few triangles left, to finish them off
+    return score + 2.f / std::sqrt((float)remainingTriangles);
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+    const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+    // Vertex to triangle adjacency, the first remaining[v] entries are live
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index: indices)
+        ++remaining[index];
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        for (uint32_t k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScores(triangleCount);
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+    }
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint32_t> cache, newCache;
+    uint32_t cursor = 0;
+    int best = -1;
+    while (output.size() < indices.size())
+    {
+        if (best < 0)
+        {   // Nothing in the cache has triangles left, restart with the next unemitted one
+            while (emitted[cursor])
+                ++cursor;
+            best = (int)cursor;
+        }
+        const uint32_t *triangle = &indices[best * 3];
+        emitted[best] = true;
+        output.insert(output.end(), triangle, triangle + 3);
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t v = triangle[k];
+            uint32_t *live = &adjacency[offsets[v]];
+            uint32_t *it = std::find(live, live + remaining[v], (uint32_t)best);
+            if (it != live + remaining[v])
+            {
+                std::swap(*it, live[remaining[v] - 1]);
+                --remaining[v];
+            }
+        }
+        newCache.assign(triangle, triangle + 3);
+        for (uint32_t v: cache)
+        {
+            if ((v != triangle[0]) && (v != triangle[1]) && (v != triangle[2]))
+                newCache.push_back(v);
+        }
+        for (uint32_t i = 0; i < (uint32_t)newCache.size(); ++i)
+        {
+            const uint32_t v = newCache[i];
+            cachePositions[v] = (i < VERTEX_CACHE_SIZE) ? (int)i : -1;
+            const float score = vertexScore(cachePositions[v], remaining[v]);
+            const float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            for (uint32_t j = 0; j < remaining[v]; ++j)
+                triangleScores[adjacency[offsets[v] + j]] += delta;
+        }
+        if (newCache.size() > VERTEX_CACHE_SIZE)
+            newCache.resize(VERTEX_CACHE_SIZE);
+        cache.swap(newCache);
+
+        best = -1;
+        float bestScore = -1.f;
+        for (uint32_t v: cache)
+        {
+            for (uint32_t j = 0; j < remaining[v]; ++j)
+            {
+                const uint32_t t = adjacency[offsets[v] + j];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = (int)t;
+                }
+            }
+        }
+    }
+    indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, float threshold)
+{   // Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+    // Clusters are cut where the cache restarts anyway, then sorted so that
+    // outward-facing clusters come first and occlude the rest.
+    const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+    if (triangleCount < OVERDRAW_MIN_CLUSTER * 2)
+        return;
+    const float acmr = computeAcmr(indices, FIFO_CACHE_SIZE);
+    std::vector<uint32_t> clusterStarts = {0};
+    {
+        std::vector<uint32_t> timestamps(vertices.size(), 0);
+        uint32_t time = FIFO_CACHE_SIZE + 1;
+        for (uint32_t t = 0; t < triangleCount; ++t)
+        {
+            uint32_t misses = 0;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t index = indices[t * 3 + k];
+                if (time - timestamps[index] > FIFO_CACHE_SIZE)
+                {
+                    timestamps[index] = time++;
+                    ++misses;
+                }
+            }
+            if ((3 == misses) && (t - clusterStarts.back() >= OVERDRAW_MIN_CLUSTER))
+                clusterStarts.push_back(t);
+        }
+    }
+    if (clusterStarts.size() < 2)
+        return;
+    clusterStarts.push_back(triangleCount);
+
+    struct Cluster
+    {
+        uint32_t begin, end;
+        float centroid[3];
+        float normal[3];
+        float area;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters(clusterStarts.size() - 1);
+    float meshCentroid[3] = {0.f, 0.f, 0.f};
+    float meshArea = 0.f;
+    for (size_t c = 0; c < clusters.size(); ++c)
+    {
+        Cluster& cluster = clusters[c];
+        cluster = Cluster{clusterStarts[c], clusterStarts[c + 1], {0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}, 0.f, 0.f};
+        for (uint32_t t = cluster.begin; t < cluster.end; ++t)
+        {
+            const float *p0 = vertices[indices[t * 3]].position;
+            const float *p1 = vertices[indices[t * 3 + 1]].position;
+            const float *p2 = vertices[indices[t * 3 + 2]].position;
+            const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            const float normal[3] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0]};
+            const float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                cluster.centroid[k] += (p0[k] + p1[k] + p2[k]) * (area / 3.f);
+                cluster.normal[k] += normal[k];
+            }
+            cluster.area += area;
+        }
+        for (int k = 0; k < 3; ++k)
+            meshCentroid[k] += cluster.centroid[k];
+        meshArea += cluster.area;
+        if (cluster.area > 0.f)
+        {
+            for (int k = 0; k < 3; ++k)
+                cluster.centroid[k] /= cluster.area;
+        }
+    }
+    if (meshArea <= 0.f)
+        return;
+    for (int k = 0; k < 3; ++k)
+        meshCentroid[k] /= meshArea;
+    for (Cluster& cluster: clusters)
+    {
+        const float length = std::sqrt(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+        for (int k = 0; k < 3; ++k)
+            cluster.sortKey += (cluster.centroid[k] - meshCentroid[k]) * (length > 0.f ? cluster.normal[k] / length : 0.f);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+        [](const Cluster& a, const Cluster& b)
+        {
+            return a.sortKey > b.sortKey;
+        });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const Cluster& cluster: clusters)
+        output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    // Keep the cache-optimized order if sorting clusters costs too much
+    if (computeAcmr(output, FIFO_CACHE_SIZE) <= acmr * threshold)
+        indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<MeshVertex>& vertices)
+{   // Vertices in order of first use, unreferenced ones are dropped
+    std::vector<uint32_t> remap(vertices.size(), ~0u);
+    uint32_t vertexCount = 0;
+    for (uint32_t& index: indices)
+    {
+        if (~0u == remap[index])
+            remap[index] = vertexCount++;
+        index = remap[index];
+    }
+    std::vector<MeshVertex> output(vertexCount);
+    for (size_t v = 0; v < vertices.size(); ++v)
+    {
+        if (remap[v] != ~0u)
+            output[remap[v]] = vertices[v];
+    }
+    vertices.swap(output);
+}
+
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent <= 0)
+    {   // Denormal or zero
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        const uint32_t shift = (uint32_t)(14 - exponent);
+        return (uint16_t)(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+    }
+    if (exponent >= 31)
+    {   // Overflow to infinity, NaN stays NaN
+        const bool nan = (((bits >> 23) & 0xFF) == 0xFF) && mantissa;
+        return (uint16_t)(sign | 0x7C00 | (nan ? 0x200 : 0));
+    }
+    // Round to nearest, carry may propagate into the exponent
+    return (uint16_t)((sign | ((uint32_t)exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+static int16_t floatToSnorm16(float value)
+{
+    return (int16_t)std::lround(std::min(std::max(value, -1.f), 1.f) * 32767.f);
+}
+
+void quantizeVertices(Mesh& mesh)
+{
+    float boundsMin[3] = {INFINITY, INFINITY, INFINITY};
+    float boundsMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (const MeshVertex& vertex: mesh.vertices)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            boundsMin[k] = std::min(boundsMin[k], vertex.position[k]);
+            boundsMax[k] = std::max(boundsMax[k], vertex.position[k]);
+        }
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+        mesh.header.boundsMin[k] = mesh.vertices.empty() ? 0.f : boundsMin[k];
+        mesh.header.boundsScale[k] = (boundsMax[k] > boundsMin[k]) ? boundsMax[k] - boundsMin[k] : 1.f;
+    }
+    mesh.quantizedVertices.resize(mesh.vertices.size());
+    for (size_t v = 0; v < mesh.vertices.size(); ++v)
+    {
+        const MeshVertex& vertex = mesh.vertices[v];
+        AssetPackVertex& quantized = mesh.quantizedVertices[v];
+        for (int k = 0; k < 3; ++k)
+        {
+            const float unorm = (vertex.position[k] - mesh.header.boundsMin[k]) / mesh.header.boundsScale[k];
+            quantized.position[k] = (uint16_t)std::lround(std::min(std::max(unorm, 0.f), 1.f) * 65535.f);
+        }
+        quantized.position[3] = 0;
+        // Octahedral encoding: project onto the octahedron, fold the lower half
+        const float *n = vertex.normal;
+        const float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+        float x = (l1 > 0.f) ? n[0] / l1 : 0.f;
+        float y = (l1 > 0.f) ? n[1] / l1 : 0.f;
+        if (n[2] < 0.f)
+        {
+            const float foldedX = (1.f - std::fabs(y)) * (x >= 0.f ? 1.f : -1.f);
+            const float foldedY = (1.f - std::fabs(x)) * (y >= 0.f ? 1.f : -1.f);
+            x = foldedX;
+            y = foldedY;
+        }
+        quantized.normal[0] = floatToSnorm16(x);
+        quantized.normal[1] = floatToSnorm16(y);
+        quantized.uv[0] = floatToHalf(vertex.uv[0]);
+        quantized.uv[1] = floatToHalf(vertex.uv[1]);
+    }
+}
+
+static void finishMeshlet(Mesh& mesh, AssetPackMeshlet& meshlet, std::vector<uint8_t>& localIndices)
+{
+    float boundsMin[3] = {INFINITY, INFINITY, INFINITY};
+    float boundsMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+        const uint32_t v = mesh.meshletVertices[meshlet.vertexOffset + i];
+        for (int k = 0; k < 3; ++k)
+        {
+            boundsMin[k] = std::min(boundsMin[k], mesh.vertices[v].position[k]);
+            boundsMax[k] = std::max(boundsMax[k], mesh.vertices[v].position[k]);
+        }
+        localIndices[v] = 0xFF;
+    }
+    float radius = 0.f;
+    for (int k = 0; k < 3; ++k)
+        meshlet.center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+    {
+        const float *p = mesh.vertices[mesh.meshletVertices[meshlet.vertexOffset + i]].position;
+        const float d[3] = {p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2]};
+        radius = std::max(radius, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
+    meshlet.radius = std::sqrt(radius);
+    mesh.meshlets.push_back(meshlet);
+    meshlet.vertexOffset = (uint32_t)mesh.meshletVertices.size();
+    meshlet.triangleOffset = (uint32_t)(mesh.meshletTriangles.size() / 3);
+    meshlet.vertexCount = 0;
+    meshlet.triangleCount = 0;
+}
+
+void buildMeshlets(Mesh& mesh, uint32_t maxVertices, uint32_t maxTriangles)
+{   // Greedy, in the final triangle order, so meshlets inherit its locality
+    std::vector<uint8_t> localIndices(mesh.vertices.size(), 0xFF);
+    AssetPackMeshlet meshlet = {};
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+        const uint32_t *triangle = &mesh.indices[i];
+        uint32_t newVertices = 0;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const bool duplicate = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            if ((0xFF == localIndices[triangle[k]]) && !duplicate)
+                ++newVertices;
+        }
+        if ((meshlet.vertexCount + newVertices > maxVertices) || (meshlet.triangleCount + 1u > maxTriangles))
+            finishMeshlet(mesh, meshlet, localIndices);
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            uint8_t& local = localIndices[triangle[k]];
+            if (0xFF == local)
+            {
+                local = (uint8_t)meshlet.vertexCount++;
+                mesh.meshletVertices.push_back(triangle[k]);
+            }
+            mesh.meshletTriangles.push_back(local);
+        }
+        ++meshlet.triangleCount;
+    }
+    if (meshlet.triangleCount)
+        finishMeshlet(mesh, meshlet, localIndices);
+}
+
+void optimizeMesh(Mesh& mesh)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    MeshStatistics& stats = mesh.stats;
+    stats.triangleCount = (uint32_t)(mesh.indices.size() / 3);
+    stats.acmrBefore = computeAcmr(mesh.indices, FIFO_CACHE_SIZE);
+    if (!mesh.vertices.empty())
+    {
+        stats.atvrBefore = stats.acmrBefore * stats.triangleCount / mesh.vertices.size();
+        stats.bytesPerVertexBefore = (float)(mesh.vertices.size() * sizeof(MeshVertex) + mesh.indices.size() * sizeof(uint32_t)) / mesh.vertices.size();
+    }
+
+    optimizeVertexCache(mesh.indices, (uint32_t)mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices, OVERDRAW_THRESHOLD);
+    optimizeVertexFetch(mesh.indices, mesh.vertices);
+    quantizeVertices(mesh);
+    buildMeshlets(mesh, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+
+    const uint32_t indexSize = (mesh.vertices.size() <= 65536) ? 2 : 4;
+    mesh.indexData.resize(mesh.indices.size() * indexSize);
+    for (size_t i = 0; i < mesh.indices.size(); ++i)
+    {
+        if (2 == indexSize)
+            ((uint16_t *)mesh.indexData.data())[i] = (uint16_t)mesh.indices[i];
+        else
+            ((uint32_t *)mesh.indexData.data())[i] = mesh.indices[i];
+    }
+    mesh.header.vertexCount = (uint32_t)mesh.vertices.size();
+    mesh.header.indexCount = (uint32_t)mesh.indices.size();
+    mesh.header.indexSize = indexSize;
+    mesh.header.meshletCount = (uint32_t)mesh.meshlets.size();
+
+    stats.vertexCount = mesh.header.vertexCount;
+    stats.meshletCount = mesh.header.meshletCount;
+    stats.acmrAfter = computeAcmr(mesh.indices, FIFO_CACHE_SIZE);
+    if (!mesh.vertices.empty())
+    {
+        stats.atvrAfter = stats.acmrAfter * stats.triangleCount / mesh.vertices.size();
+        stats.bytesPerVertexAfter = (float)(mesh.quantizedVertices.size() * sizeof(AssetPackVertex) + mesh.indexData.size()) / mesh.vertices.size();
+    }
+    stats.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void optimizeMeshes(std::vector<Mesh>& meshes)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&meshes, &next]()
+    {
+        for (size_t i = next++; i < meshes.size(); i = next++)
+            optimizeMesh(meshes[i]);
+    };
+    const size_t threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), meshes.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread: threads)
+        thread.join();
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../assetPackFormat.h"
+
+// Mesh preprocessing for the asset pack: triangles are reordered for the
+// post-transform vertex cache and then, in clusters, for less overdraw;
+// vertices are reordered for fetch locality and quantized; meshlets are
+// built from the final triangle order. Nothing here depends on Vulkan,
+// so the same code can run at load time.
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+struct MeshStatistics
+{
+    uint32_t vertexCount = 0;
+    uint32_t triangleCount = 0;
+    uint32_t meshletCount = 0;
+    float acmrBefore = 0.f; // Average cache miss ratio, per triangle
+    float acmrAfter = 0.f;
+    float atvrBefore = 0.f; // Average transformed vertex ratio, per vertex
+    float atvrAfter = 0.f;
+    float bytesPerVertexBefore = 0.f; // Including indices
+    float bytesPerVertexAfter = 0.f;
+    float milliseconds = 0.f;
+};
+
+struct Mesh
+{
+    std::string name;
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    AssetPackMesh header;
+    std::vector<AssetPackVertex> quantizedVertices;
+    std::vector<uint8_t> indexData; // 16-bit if vertex count allows
+    std::vector<AssetPackMeshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint8_t> meshletTriangles;
+    MeshStatistics stats;
+};
+
+bool loadObj(const char *fileName, Mesh& mesh);
+float computeAcmr(const std::vector<uint32_t>& indices, uint32_t cacheSize);
+void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, float threshold);
+void optimizeVertexFetch(std::vector<uint32_t>& indices, std::vector<MeshVertex>& vertices);
+void quantizeVertices(Mesh& mesh);
+void buildMeshlets(Mesh& mesh, uint32_t maxVertices, uint32_t maxTriangles);
+void optimizeMesh(Mesh& mesh);
+void optimizeMeshes(std::vector<Mesh>& meshes); // In parallel, one mesh per task
@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../assetPackFormat.h"
+#include "meshOptimizer.h"
+
+#define FORMAT_R8G8B8A8_UNORM 37 // VkFormat
+#define SYNTHETIC_IMAGE_SIZE 2048
+#define SYNTHETIC_BUFFER_SIZE (32 * 1024 * 1024)
+
+// Builds a binary asset pack for AssetPack. Raw buffers are stored as is,
+// RGBA8 images get their full mip chain generated here and OBJ meshes are
+// optimized and quantized, so that the loader does nothing but copy blobs
+// to the GPU.
+struct Blob
+{
+    AssetPackEntry entry;
+    std::function<void(std::vector<uint8_t>&)> load;
+};
+
+static uint64_t alignUp(uint64_t size, uint64_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t mipLevels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        ++mipLevels;
+    return mipLevels;
+}
+
+static uint64_t mipChainSize(uint32_t width, uint32_t height, uint32_t texelSize)
+{
+    uint64_t size = 0;
+    for (uint32_t mipLevel = 0; mipLevel < mipLevelCount(width, height); ++mipLevel)
+        size += (uint64_t)std::max(width >> mipLevel, 1u) * std::max(height >> mipLevel, 1u) * texelSize;
+    return size;
+}
+
+static bool readFile(const char *fileName, std::vector<uint8_t>& data)
+{
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    data.resize((size_t)file.tellg());
+    file.seekg(0);
+    return (bool)file.read((char *)data.data(), data.size());
+}
+
+static void generateMips(std::vector<uint8_t>& data, uint32_t width, uint32_t height)
+{   // 2x2 box filter of RGBA8 texels, level 0 is already in place
+    const size_t size = (size_t)mipChainSize(width, height, 4);
+    data.resize(size);
+    size_t srcOffset = 0;
+    size_t dstOffset = (size_t)width * height * 4;
+    for (uint32_t mipLevel = 1; mipLevel < mipLevelCount(width, height); ++mipLevel)
+    {
+        const uint32_t srcWidth = std::max(width >> (mipLevel - 1), 1u);
+        const uint32_t srcHeight = std::max(height >> (mipLevel - 1), 1u);
+        const uint32_t dstWidth = std::max(width >> mipLevel, 1u);
+        const uint32_t dstHeight = std::max(height >> mipLevel, 1u);
+        for (uint32_t y = 0; y < dstHeight; ++y)
+        {
+            for (uint32_t x = 0; x < dstWidth; ++x)
+            {
+                const uint32_t x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+                const uint32_t y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    const uint32_t sum =
+                        data[srcOffset + (y0 * srcWidth + x0) * 4 + c] +
+                        data[srcOffset + (y0 * srcWidth + x1) * 4 + c] +
+                        data[srcOffset + (y1 * srcWidth + x0) * 4 + c] +
+                        data[srcOffset + (y1 * srcWidth + x1) * 4 + c];
+                    data[dstOffset + (y * dstWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+        srcOffset = dstOffset;
+        dstOffset += (size_t)dstWidth * dstHeight * 4;
+    }
+}
+
+static AssetPackEntry makeEntry(const char *name, AssetPackEntryType type)
+{
+    AssetPackEntry entry = {};
+    snprintf(entry.name, sizeof(entry.name), "%s", name);
+    entry.type = type;
+    return entry;
+}
+
+static Blob bufferBlob(const char *name, const char *fileName)
+{
+    std::vector<uint8_t> data;
+    if (!readFile(fileName, data))
+        throw std::runtime_error(std::string("failed to read ") + fileName);
+    Blob blob;
+    blob.entry = makeEntry(name, AssetPackBuffer);
+    blob.entry.size = data.size();
+    blob.load = [data](std::vector<uint8_t>& dst) { dst = data; };
+    return blob;
+}
+
+static Blob imageBlob(const char *name, const char *fileName, uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> data;
+    if (!readFile(fileName, data))
+        throw std::runtime_error(std::string("failed to read ") + fileName);
+    if (data.size() != (size_t)width * height * 4)
+        throw std::runtime_error(std::string(fileName) + " is not a raw RGBA8 image of the given size");
+    Blob blob;
+    blob.entry = makeEntry(name, AssetPackImage);
+    blob.entry.format = FORMAT_R8G8B8A8_UNORM;
+    blob.entry.width = width;
+    blob.entry.height = height;
+    blob.entry.mipLevels = mipLevelCount(width, height);
+    blob.entry.texelSize = 4;
+    blob.entry.size = mipChainSize(width, height, 4);
+    blob.load = [data, width, height](std::vector<uint8_t>& dst)
+    {
+        dst = data;
+        generateMips(dst, width, height);
+    };
+    return blob;
+}
+
+static void addSyntheticBlobs(std::vector<Blob>& blobs, uint32_t megabytes)
+{   // Alternate images and buffers until the requested size is reached
+    uint64_t total = 0;
+    for (uint32_t i = 0; total < (uint64_t)megabytes * 1024 * 1024; ++i)
+    {
+        char name[48];
+        Blob blob;
+        if (i % 2)
+        {
+            snprintf(name, sizeof(name), "synthetic_buffer_%u", i / 2);
+            blob.entry = makeEntry(name, AssetPackBuffer);
+            blob.entry.size = SYNTHETIC_BUFFER_SIZE;
+            blob.load = [i](std::vector<uint8_t>& dst)
+            {
+                dst.resize(SYNTHETIC_BUFFER_SIZE);
+                uint32_t *words = (uint32_t *)dst.data();
+                for (size_t j = 0; j < dst.size() / 4; ++j)
+                    words[j] = (uint32_t)j * 2654435761u + i;
+            };
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "synthetic_image_%u", i / 2);
+            blob.entry = makeEntry(name, AssetPackImage);
+            blob.entry.format = FORMAT_R8G8B8A8_UNORM;
+            blob.entry.width = SYNTHETIC_IMAGE_SIZE;
+            blob.entry.height = SYNTHETIC_IMAGE_SIZE;
+            blob.entry.mipLevels = mipLevelCount(SYNTHETIC_IMAGE_SIZE, SYNTHETIC_IMAGE_SIZE);
+            blob.entry.texelSize = 4;
+            blob.entry.size = mipChainSize(SYNTHETIC_IMAGE_SIZE, SYNTHETIC_IMAGE_SIZE, 4);
+            blob.load = [i](std::vector<uint8_t>& dst)
+            {   // Checkerboard
+                dst.resize(SYNTHETIC_IMAGE_SIZE * SYNTHETIC_IMAGE_SIZE * 4);
+                uint32_t *texels = (uint32_t *)dst.data();
+                for (uint32_t y = 0; y < SYNTHETIC_IMAGE_SIZE; ++y)
+                {
+                    for (uint32_t x = 0; x < SYNTHETIC_IMAGE_SIZE; ++x)
+                        texels[y * SYNTHETIC_IMAGE_SIZE + x] = ((x ^ y) & 64) ? 0xFFFFFFFF : 0xFF000000 | (i * 0x3F1F);
+                }
+                generateMips(dst, SYNTHETIC_IMAGE_SIZE, SYNTHETIC_IMAGE_SIZE);
+            };
+        }
+        total += blob.entry.size;
+        blobs.push_back(blob);
+    }
+}
+
+template<typename T>
+static Blob meshBlob(const std::shared_ptr<std::vector<Mesh>>& meshes, size_t meshIndex, const char *suffix,
+    std::vector<T> Mesh::*member)
+{
+    const Mesh& mesh = (*meshes)[meshIndex];
+    Blob blob;
+    blob.entry = makeEntry((mesh.name + suffix).c_str(), AssetPackBuffer);
+    blob.entry.size = (mesh.*member).size() * sizeof(T);
+    blob.load = [meshes, meshIndex, member](std::vector<uint8_t>& dst)
+    {
+        const std::vector<T>& src = (*meshes)[meshIndex].*member;
+        dst.resize(src.size() * sizeof(T));
+        if (!src.empty())
+            memcpy(dst.data(), src.data(), dst.size());
+    };
+    return blob;
+}
+
+static void addMeshBlobs(std::vector<Blob>& blobs, const std::shared_ptr<std::vector<Mesh>>& meshes)
+{
+    if (meshes->empty())
+        return;
+    optimizeMeshes(*meshes);
+    printf("%-24s %9s %9s %8s %13s %13s %15s %9s\n",
+        "mesh", "vertices", "triangles", "meshlets", "ACMR", "ATVR", "bytes/vertex", "ms");
+    for (size_t i = 0; i < meshes->size(); ++i)
+    {
+        const Mesh& mesh = (*meshes)[i];
+        const MeshStatistics& stats = mesh.stats;
+        printf("%-24s %9u %9u %8u %6.3f %6.3f %6.3f %6.3f %7.2f %7.2f %9.2f\n",
+            mesh.name.c_str(), stats.vertexCount, stats.triangleCount, stats.meshletCount,
+            stats.acmrBefore, stats.acmrAfter, stats.atvrBefore, stats.atvrAfter,
+            stats.bytesPerVertexBefore, stats.bytesPerVertexAfter, stats.milliseconds);
+        Blob header;
+        header.entry = makeEntry((mesh.name + ".mesh").c_str(), AssetPackBuffer);
+        header.entry.size = sizeof(AssetPackMesh);
+        header.load = [meshes, i](std::vector<uint8_t>& dst)
+        {
+            dst.resize(sizeof(AssetPackMesh));
+            memcpy(dst.data(), &(*meshes)[i].header, sizeof(AssetPackMesh));
+        };
+        blobs.push_back(header);
+        blobs.push_back(meshBlob(meshes, i, ".vertices", &Mesh::quantizedVertices));
+        blobs.push_back(meshBlob(meshes, i, ".indices", &Mesh::indexData));
+        blobs.push_back(meshBlob(meshes, i, ".meshlets", &Mesh::meshlets));
+        blobs.push_back(meshBlob(meshes, i, ".meshletVertices", &Mesh::meshletVertices));
+        blobs.push_back(meshBlob(meshes, i, ".meshletTriangles", &Mesh::meshletTriangles));
+    }
+}
+
+static void writePack(const char *fileName, std::vector<Blob>& blobs)
+{
+    AssetPackHeader header;
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = (uint32_t)blobs.size();
+    header.alignment = ASSET_PACK_ALIGNMENT;
+    uint64_t offset = alignUp(sizeof(AssetPackHeader) + blobs.size() * sizeof(AssetPackEntry), ASSET_PACK_ALIGNMENT);
+    for (Blob& blob: blobs)
+    {
+        blob.entry.offset = offset;
+        offset = alignUp(offset + blob.entry.size, ASSET_PACK_ALIGNMENT);
+    }
+    header.fileSize = offset;
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error(std::string("failed to create ") + fileName);
+    file.write((const char *)&header, sizeof(header));
+    for (const Blob& blob: blobs)
+        file.write((const char *)&blob.entry, sizeof(AssetPackEntry));
+    std::vector<uint8_t> data;
+    for (const Blob& blob: blobs)
+    {   // One blob in memory at a time
+        file.seekp((std::streamoff)blob.entry.offset);
+        blob.load(data);
+        file.write((const char *)data.data(), data.size());
+        printf("%-48s %12llu bytes\n", blob.entry.name, (unsigned long long)blob.entry.size);
+    }
+    // Pad to alignment, so that the whole file can be imported as host memory
+    file.seekp((std::streamoff)header.fileSize - 1);
+    file.put(0);
+    if (!file)
+        throw std::runtime_error(std::string("failed to write ") + fileName);
+    printf("%u entries, %llu bytes written to %s\n", header.entryCount, (unsigned long long)header.fileSize, fileName);
+}
+
+static void usage()
+{
+    printf("usage: packTool <output.pack> [options]\n"
+        "  -buffer <name> <file>                 raw buffer data\n"
+        "  -image <name> <file> <width> <height> raw RGBA8 texels, mip chain is generated\n"
+        "  -mesh <name> <file.obj>               optimized, quantized mesh with meshlets\n"
+        "  -synthetic <megabytes>                generated images and buffers for load benchmarking\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        usage();
+        return 1;
+    }
+    std::vector<Blob> blobs;
+    auto meshes = std::make_shared<std::vector<Mesh>>();
+    try
+    {
+        for (int i = 2; i < argc; ++i)
+        {
+            if (!strcmp(argv[i], "-buffer") && (i + 2 < argc))
+            {
+                blobs.push_back(bufferBlob(argv[i + 1], argv[i + 2]));
+                i += 2;
+            }
+            else if (!strcmp(argv[i], "-image") && (i + 4 < argc))
+            {
+                blobs.push_back(imageBlob(argv[i + 1], argv[i + 2], (uint32_t)atoi(argv[i + 3]), (uint32_t)atoi(argv[i + 4])));
+                i += 4;
+            }
+            else if (!strcmp(argv[i], "-mesh") && (i + 2 < argc))
+            {
+                if (strlen(argv[i + 1]) > sizeof(AssetPackEntry::name) - sizeof(".meshletTriangles"))
+                    throw std::runtime_error(std::string("mesh name is too long: ") + argv[i + 1]);
+                Mesh mesh;
+                mesh.name = argv[i + 1];
+                if (!loadObj(argv[i + 2], mesh))
+                    throw std::runtime_error(std::string("failed to load ") + argv[i + 2]);
+                meshes->push_back(std::move(mesh));
+                i += 2;
+            }
+            else if (!strcmp(argv[i], "-synthetic") && (i + 1 < argc))
+            {
+                addSyntheticBlobs(blobs, (uint32_t)atoi(argv[i + 1]));
+                i += 1;
+            }
+            else
+            {
+                usage();
+                return 1;
+            }
+        }
+        addMeshBlobs(blobs, meshes); // Meshes are optimized in parallel
+        writePack(argv[1], blobs);
+    }
+    catch (const std::exception& exc)
+    {
+        fprintf(stderr, "%s\n", exc.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,472 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <windows.h>
+#include "pipelineCompiler.h"
+
+#define PIPELINE_LIST_MAGIC 0x4C505056 // "VPPL"
+#define PIPELINE_LIST_VERSION 2
+#define PIPELINE_LIST_MAX_COUNT 65536
+
+#define CHECK_SUCCEEDED(result, message)\
+    if (VK_SUCCESS != result)\
+        throw std::runtime_error(message)
+
+PipelineCompiler::PipelineCompiler(VkDevice device_, VkPipelineLayout layout_, HostAllocator& allocator_, Profiler& profiler_,
+    uint32_t threadCount, bool dynamicRendering_):
+    device(device_),
+    layout(layout_),
+    allocator(allocator_),
+    profiler(profiler_),
+    dynamicRendering(dynamicRendering_)
+{
+    VkPipelineCacheCreateInfo pipelineCacheInfo;
+    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheInfo.pNext = nullptr;
+    pipelineCacheInfo.flags = 0; // Shared by workers, the driver synchronizes it
+    pipelineCacheInfo.initialDataSize = 0;
+    pipelineCacheInfo.pInitialData = nullptr;
+    const VkResult result = vkCreatePipelineCache(device, &pipelineCacheInfo,
+        allocator.callbacks(VK_OBJECT_TYPE_PIPELINE_CACHE), &pipelineCache);
+    CHECK_SUCCEEDED(result, "failed to create pipeline cache");
+    for (uint32_t i = 0; i < std::max(threadCount, 1u); ++i)
+    {   // Below render and submit threads, compilation only uses spare cycles while frames are running
+        threads.emplace_back(&PipelineCompiler::run, this);
+        SetThreadPriority(threads.back().native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+    }
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wakeUp.notify_all();
+    for (auto& thread: threads)
+        thread.join();
+    for (auto const& entry: entries)
+    {
+        if (Ready == entry.state)
+            vkDestroyPipeline(device, entry.pipeline, allocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+    }
+    for (auto const& shaderModule: shaderModules)
+        vkDestroyShaderModule(device, shaderModule.second, allocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    vkDestroyPipelineCache(device, pipelineCache, allocator.callbacks(VK_OBJECT_TYPE_PIPELINE_CACHE));
+}
+
+uint32_t PipelineCompiler::addRenderPass(VkRenderPass renderPass)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    renderPasses.push_back(renderPass);
+    return (uint32_t)renderPasses.size() - 1;
+}
+
+PipelineCompiler::Handle PipelineCompiler::request(const Desc& desc, Handle placeholder)
+{
+    assert((invalidHandle == placeholder) || (placeholder < entries.size()));
+    const uint64_t key = hash(desc);
+    const auto range = handles.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it)
+    {   // Already requested, possibly by warm-up that had no placeholder
+        Entry& entry = entries[it->second];
+        if (memcmp(&entry.desc, &desc, sizeof(Desc)))
+            continue; // Hash collision
+        if (invalidHandle == entry.placeholder)
+            entry.placeholder = placeholder;
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.requestCount;
+        ++stats.duplicateCount;
+        return it->second;
+    }
+    const Handle handle = (Handle)entries.size();
+    entries.emplace_back();
+    Entry& entry = entries.back();
+    entry.desc = desc;
+    entry.placeholder = placeholder;
+    handles.emplace(key, handle);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(&entry);
+        ++pendingCount;
+        ++stats.requestCount;
+    }
+    wakeUp.notify_one();
+    return handle;
+}
+
+VkPipeline PipelineCompiler::get(Handle handle) const
+{   // Follow placeholders until one is ready
+    while (handle != invalidHandle)
+    {
+        const Entry& entry = entries[handle];
+        if (Ready == entry.state.load(std::memory_order_acquire))
+            return entry.pipeline;
+        handle = entry.placeholder;
+    }
+    return VK_NULL_HANDLE;
+}
+
+bool PipelineCompiler::ready(Handle handle) const
+{
+    return Ready == entries[handle].state.load(std::memory_order_acquire);
+}
+
+void PipelineCompiler::wait(Handle handle)
+{
+    const Entry& entry = entries[handle];
+    std::unique_lock<std::mutex> lock(mutex);
+    completed.wait(lock, [&entry] { return entry.state != Pending; });
+}
+
+void PipelineCompiler::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    completed.wait(lock, [this] { return 0 == pendingCount; });
+}
+
+uint32_t PipelineCompiler::warmUp(const char *fileName)
+{
+    std::ifstream file(fileName, std::ios::binary);
+    ListHeader header = {};
+    if (!file.read((char *)&header, sizeof(header)) ||
+        (header.magic != PIPELINE_LIST_MAGIC) ||
+        (header.version != PIPELINE_LIST_VERSION) ||
+        (header.descSize != sizeof(Desc)) ||
+        (header.descCount > PIPELINE_LIST_MAX_COUNT))
+    {
+        return 0; // Not recorded yet or by another build
+    }
+    const auto begin = Clock::now();
+    std::vector<Desc> descs(header.descCount);
+    if (!file.read((char *)descs.data(), descs.size() * sizeof(Desc)))
+        return 0;
+    uint32_t requestCount = 0;
+    for (auto const& desc: descs)
+    {   // Skip targets that this run doesn't have
+        if ((VK_PIPELINE_BIND_POINT_COMPUTE == desc.bindPoint) ||
+            (desc.renderPass < renderPasses.size()) ||
+            ((dynamicRenderingPass == desc.renderPass) && dynamicRendering))
+        {
+            request(desc);
+            ++requestCount;
+        }
+    }
+    waitIdle();
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.warmUpTime = std::chrono::duration<float, std::milli>(Clock::now() - begin).count();
+    return requestCount;
+}
+
+bool PipelineCompiler::writePipelineList(const char *fileName) const
+{
+    std::vector<Desc> descs;
+    for (auto const& entry: entries)
+    {
+        if (entry.state != Failed)
+            descs.push_back(entry.desc);
+    }
+    ListHeader header;
+    header.magic = PIPELINE_LIST_MAGIC;
+    header.version = PIPELINE_LIST_VERSION;
+    header.descSize = sizeof(Desc);
+    header.descCount = (uint32_t)descs.size();
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    file.write((const char *)&header, sizeof(header));
+    file.write((const char *)descs.data(), descs.size() * sizeof(Desc));
+    return (bool)file;
+}
+
+PipelineCompiler::Statistics PipelineCompiler::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+PipelineCompiler::Desc PipelineCompiler::graphicsDesc(const char *vertexShader, const char *fragmentShader, uint32_t renderPass)
+{
+    Desc desc;
+    memset(&desc, 0, sizeof(Desc)); // No garbage in hashed bytes
+    desc.bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    snprintf(desc.shaders[0], sizeof(desc.shaders[0]), "%s", vertexShader);
+    snprintf(desc.shaders[1], sizeof(desc.shaders[1]), "%s", fragmentShader);
+    desc.renderPass = renderPass;
+    desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    desc.cullMode = VK_CULL_MODE_NONE;
+    desc.blendEnable = VK_FALSE;
+    return desc;
+}
+
+PipelineCompiler::Desc PipelineCompiler::dynamicRenderingDesc(const char *vertexShader, const char *fragmentShader, VkFormat colorFormat)
+{
+    Desc desc = graphicsDesc(vertexShader, fragmentShader, dynamicRenderingPass);
+    desc.colorFormat = colorFormat;
+    return desc;
+}
+
+PipelineCompiler::Desc PipelineCompiler::computeDesc(const char *computeShader)
+{
+    Desc desc;
+    memset(&desc, 0, sizeof(Desc));
+    desc.bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+    snprintf(desc.shaders[0], sizeof(desc.shaders[0]), "%s", computeShader);
+    return desc;
+}
+
+bool PipelineCompiler::parseWarmUp(const char *commandLine)
+{
+    return commandLine && strstr(commandLine, "-warmup");
+}
+
+void PipelineCompiler::run()
+{
+    profiler.setThreadName("pipeline compiler");
+    for (;;)
+    {
+        Entry *entry;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this] { return quit || !jobs.empty(); });
+            if (quit)
+                break;
+            entry = jobs.front();
+            jobs.pop_front();
+        }
+        const auto begin = Clock::now();
+        const VkResult result = compile(*entry);
+        const float compileTime = std::chrono::duration<float, std::milli>(Clock::now() - begin).count();
+        if (result != VK_SUCCESS)
+        {
+            char message[160];
+            snprintf(message, sizeof(message), "failed to compile pipeline %s %s\n",
+                entry->desc.shaders[0], entry->desc.shaders[1]);
+            OutputDebugStringA(message);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            entry->state.store((VK_SUCCESS == result) ? Ready : Failed, std::memory_order_release);
+            --pendingCount;
+            if (VK_SUCCESS == result)
+                ++stats.compiledCount;
+            else
+                ++stats.failedCount;
+            stats.totalCompileTime += compileTime;
+            stats.maxCompileTime = std::max(stats.maxCompileTime, compileTime);
+        }
+        completed.notify_all();
+    }
+}
+
+VkResult PipelineCompiler::compile(Entry& entry)
+{
+    Profiler::CpuZone zone(profiler, "compile pipeline");
+    if (VK_PIPELINE_BIND_POINT_COMPUTE == entry.desc.bindPoint)
+        return createComputePipeline(entry.desc, &entry.pipeline);
+    return createGraphicsPipeline(entry.desc, &entry.pipeline);
+}
+
+VkResult PipelineCompiler::createGraphicsPipeline(const Desc& desc, VkPipeline *pipeline)
+{
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    if (desc.renderPass != dynamicRenderingPass)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        renderPass = renderPasses[desc.renderPass];
+    }
+    // Attachment formats are given instead of a render pass
+    VkPipelineRenderingCreateInfoKHR renderingInfo;
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.pNext = nullptr;
+    renderingInfo.viewMask = 0;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &desc.colorFormat;
+    renderingInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
+    for (uint32_t i = 0; i < (uint32_t)shaderStages.size(); ++i)
+    {
+        shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[i].pNext = nullptr;
+        shaderStages[i].flags = 0;
+        shaderStages[i].stage = i ? VK_SHADER_STAGE_FRAGMENT_BIT : VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[i].module = getShaderModule(desc.shaders[i]);
+        shaderStages[i].pName = "main";
+        shaderStages[i].pSpecializationInfo = nullptr;
+        if (VK_NULL_HANDLE == shaderStages[i].module)
+            return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputState;
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputState.pNext = nullptr;
+    vertexInputState.flags = 0;
+    vertexInputState.vertexBindingDescriptionCount = 0; // Vertices are generated or pulled from buffers
+    vertexInputState.pVertexBindingDescriptions = nullptr;
+    vertexInputState.vertexAttributeDescriptionCount = 0;
+    vertexInputState.pVertexAttributeDescriptions = nullptr;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState;
+    inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyState.pNext = nullptr;
+    inputAssemblyState.flags = 0;
+    inputAssemblyState.topology = desc.topology;
+    inputAssemblyState.primitiveRestartEnable = VK_FALSE;
+
+    VkPipelineViewportStateCreateInfo viewportState;
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.pNext = nullptr;
+    viewportState.flags = 0;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = nullptr; // Dynamic
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = nullptr;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationState;
+    rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationState.pNext = nullptr;
+    rasterizationState.flags = 0;
+    rasterizationState.depthClampEnable = VK_FALSE;
+    rasterizationState.rasterizerDiscardEnable = VK_FALSE;
+    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationState.cullMode = desc.cullMode;
+    rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationState.depthBiasEnable = VK_FALSE;
+    rasterizationState.depthBiasConstantFactor = 0.f;
+    rasterizationState.depthBiasClamp = 0.f;
+    rasterizationState.depthBiasSlopeFactor = 0.f;
+    rasterizationState.lineWidth = 1.f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleState;
+    multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleState.pNext = nullptr;
+    multisampleState.flags = 0;
+    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampleState.sampleShadingEnable = VK_FALSE;
+    multisampleState.minSampleShading = 0.f;
+    multisampleState.pSampleMask = nullptr;
+    multisampleState.alphaToCoverageEnable = VK_FALSE;
+    multisampleState.alphaToOneEnable = VK_FALSE;
+
+    VkPipelineColorBlendAttachmentState blendAttachmentState;
+    blendAttachmentState.blendEnable = desc.blendEnable;
+    blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    blendAttachmentState.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendState;
+    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendState.pNext = nullptr;
+    colorBlendState.flags = 0;
+    colorBlendState.logicOpEnable = VK_FALSE;
+    colorBlendState.logicOp = VK_LOGIC_OP_COPY;
+    colorBlendState.attachmentCount = 1;
+    colorBlendState.pAttachments = &blendAttachmentState;
+    colorBlendState.blendConstants[0] = 0.f;
+    colorBlendState.blendConstants[1] = 0.f;
+    colorBlendState.blendConstants[2] = 0.f;
+    colorBlendState.blendConstants[3] = 0.f;
+
+    // Render extent changes with dynamic resolution, don't bake it in
+    const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState;
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.pNext = nullptr;
+    dynamicState.flags = 0;
+    dynamicState.dynamicStateCount = (uint32_t)_countof(dynamicStates);
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo;
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = (VK_NULL_HANDLE == renderPass) ? &renderingInfo : nullptr;
+    pipelineInfo.flags = 0;
+    pipelineInfo.stageCount = (uint32_t)shaderStages.size();
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputState;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyState;
+    pipelineInfo.pTessellationState = nullptr;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizationState;
+    pipelineInfo.pMultisampleState = &multisampleState;
+    pipelineInfo.pDepthStencilState = nullptr;
+    pipelineInfo.pColorBlendState = &colorBlendState;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+    return vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo,
+        allocator.callbacks(VK_OBJECT_TYPE_PIPELINE), pipeline);
+}
+
+VkResult PipelineCompiler::createComputePipeline(const Desc& desc, VkPipeline *pipeline)
+{
+    VkComputePipelineCreateInfo pipelineInfo;
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = nullptr;
+    pipelineInfo.flags = 0;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.pNext = nullptr;
+    pipelineInfo.stage.flags = 0;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = getShaderModule(desc.shaders[0]);
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = nullptr;
+    pipelineInfo.layout = layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+    if (VK_NULL_HANDLE == pipelineInfo.stage.module)
+        return VK_ERROR_INITIALIZATION_FAILED;
+    return vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo,
+        allocator.callbacks(VK_OBJECT_TYPE_PIPELINE), pipeline);
+}
+
+VkShaderModule PipelineCompiler::getShaderModule(const char *fileName)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = shaderModules.find(fileName);
+        if (it != shaderModules.end())
+            return it->second;
+    }
+    // Loaded outside of the lock, a worker that loses the race drops its copy
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file)
+        return VK_NULL_HANDLE;
+    std::vector<uint32_t> code(((size_t)file.tellg() + 3) / 4);
+    file.seekg(0);
+    if (code.empty() || !file.read((char *)code.data(), code.size() * 4))
+        return VK_NULL_HANDLE;
+
+    VkShaderModuleCreateInfo shaderModuleInfo;
+    shaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleInfo.pNext = nullptr;
+    shaderModuleInfo.flags = 0;
+    shaderModuleInfo.codeSize = code.size() * 4;
+    shaderModuleInfo.pCode = code.data();
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &shaderModuleInfo, allocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE), &shaderModule) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto result = shaderModules.emplace(fileName, shaderModule);
+    if (!result.second)
+        vkDestroyShaderModule(device, shaderModule, allocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    return result.first->second;
+}
+
+uint64_t PipelineCompiler::hash(const Desc& desc)
+{   // FNV-1a
+    uint64_t value = 14695981039346656037ull;
+    const uint8_t *bytes = (const uint8_t *)&desc;
+    for (size_t i = 0; i < sizeof(Desc); ++i)
+        value = (value ^ bytes[i]) * 1099511628211ull;
+    return value;
+}
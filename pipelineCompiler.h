@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "allocator.h"
+#include "profiler.h"
+
+// Compiles pipelines on a pool of worker threads, so that the frame loop
+// never blocks in vkCreate*Pipelines. request() returns a handle at once;
+// until its pipeline is ready, get() resolves to the placeholder given
+// with the request, typically a cheap pipeline compiled up front.
+// Requests are deduplicated by a hash of their description. Every request
+// can be recorded to a file and compiled again at startup, on all cores,
+// before the first frame.
+class PipelineCompiler
+{
+public:
+    typedef uint32_t Handle;
+    static constexpr Handle invalidHandle = ~0u;
+    static constexpr uint32_t dynamicRenderingPass = ~0u; // Desc::renderPass without VkRenderPass
+
+    struct Desc
+    {   // Hashed and recorded byte by byte, so create with graphicsDesc() or computeDesc()
+        VkPipelineBindPoint bindPoint;
+        char shaders[2][48]; // SPIR-V files, vertex and fragment or compute
+        uint32_t renderPass; // Index returned by addRenderPass() or dynamicRenderingPass
+        VkFormat colorFormat; // Dynamic rendering only
+        VkPrimitiveTopology topology;
+        VkCullModeFlags cullMode;
+        VkBool32 blendEnable;
+    };
+
+    struct Statistics
+    {
+        uint32_t requestCount = 0;
+        uint32_t duplicateCount = 0;
+        uint32_t compiledCount = 0;
+        uint32_t failedCount = 0;
+        float totalCompileTime = 0.f; // Milliseconds, summed over workers
+        float maxCompileTime = 0.f;
+        float warmUpTime = 0.f;
+    };
+
+    PipelineCompiler(VkDevice device, VkPipelineLayout layout, HostAllocator& allocator, Profiler& profiler,
+        uint32_t threadCount, bool dynamicRendering);
+    ~PipelineCompiler();
+    uint32_t addRenderPass(VkRenderPass renderPass);
+    Handle request(const Desc& desc, Handle placeholder = invalidHandle);
+    VkPipeline get(Handle handle) const;
+    bool ready(Handle handle) const;
+    void wait(Handle handle);
+    void waitIdle();
+    uint32_t warmUp(const char *fileName);
+    bool writePipelineList(const char *fileName) const;
+    Statistics getStatistics() const;
+    static Desc graphicsDesc(const char *vertexShader, const char *fragmentShader, uint32_t renderPass);
+    static Desc dynamicRenderingDesc(const char *vertexShader, const char *fragmentShader, VkFormat colorFormat);
+    static Desc computeDesc(const char *computeShader);
+    static bool parseWarmUp(const char *commandLine);
+
+private:
+    enum State { Pending, Ready, Failed };
+
+    struct Entry
+    {
+        Desc desc;
+        Handle placeholder = invalidHandle;
+        VkPipeline pipeline = VK_NULL_HANDLE; // Published by state
+        std::atomic<int> state{Pending};
+    };
+
+    struct ListHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t descSize;
+        uint32_t descCount;
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    void run();
+    VkResult compile(Entry& entry);
+    VkResult createGraphicsPipeline(const Desc& desc, VkPipeline *pipeline);
+    VkResult createComputePipeline(const Desc& desc, VkPipeline *pipeline);
+    VkShaderModule getShaderModule(const char *fileName);
+    static uint64_t hash(const Desc& desc);
+
+    VkDevice device;
+    VkPipelineLayout layout;
+    HostAllocator& allocator;
+    Profiler& profiler;
+    const bool dynamicRendering;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    // Entries and the hash map belong to the requesting thread,
+    // workers only see entries through the job queue
+    std::deque<Entry> entries;
+    std::unordered_multimap<uint64_t, Handle> handles; // Colliding descs are told apart by memcmp
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable completed;
+    std::deque<Entry *> jobs;
+    uint32_t pendingCount = 0;
+    bool quit = false;
+    std::vector<VkRenderPass> renderPasses;
+    std::unordered_map<std::string, VkShaderModule> shaderModules;
+    Statistics stats;
+    std::vector<std::thread> threads;
+};
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+#include "profiler.h"
+
+#define GPU_THREAD_ID 0
+
+// Ordered by bit position, as returned by vkGetQueryPoolResults
+static const char *statisticNames[] = {
+    "input assembly vertices",
+    "vertex shader invocations",
+    "clipping primitives",
+    "fragment shader invocations",
+    "compute shader invocations"
+};
+
+Profiler::CpuZone::CpuZone(Profiler& profiler_, const char *name_):
+    profiler(profiler_),
+    name(name_),
+    begin(Profiler::now())
+{}
+
+Profiler::CpuZone::~CpuZone()
+{
+    Event event;
+    event.name = name;
+    event.threadId = GetCurrentThreadId();
+    event.begin = begin;
+    event.end = Profiler::now();
+    event.hasStatistics = false;
+    profiler.addEvent(event);
+}
+
+Profiler::GpuZone::GpuZone(Profiler& profiler_, VkCommandBuffer cmdBuffer_, const char *name):
+    profiler(profiler_),
+    cmdBuffer(cmdBuffer_),
+    zoneIndex(profiler_.beginGpuZone(cmdBuffer_, name))
+{}
+
+Profiler::GpuZone::~GpuZone()
+{
+    profiler.endGpuZone(cmdBuffer, zoneIndex);
+}
+
+Profiler::Profiler()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&counter);
+    frequency = counter.QuadPart;
+    startTicks = now();
+    threadNames.emplace_back(GPU_THREAD_ID, "GPU");
+}
+
+void Profiler::createQueryPools(VkPhysicalDevice physicalDevice, VkDevice device_, uint32_t timestampValidBits,
+    uint32_t frameCount, bool calibratedTimestamps, bool pipelineStatistics,
+    const VkAllocationCallbacks *allocator_)
+{
+    if (!timestampValidBits)
+    {
+        OutputDebugStringA("queue doesn't support timestamps, GPU zones disabled\n");
+        return;
+    }
+    device = device_;
+    allocator = allocator_;
+    timestampMask = (timestampValidBits < 64) ? (1ull << timestampValidBits) - 1 : ~0ull;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+    if (calibratedTimestamps)
+    {
+        vkGetCalibratedTimestampsEXT = (PFN_vkGetCalibratedTimestampsEXT)
+            vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT");
+    }
+
+    VkQueryPoolCreateInfo timestampPoolInfo;
+    timestampPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    timestampPoolInfo.pNext = nullptr;
+    timestampPoolInfo.flags = 0;
+    timestampPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    timestampPoolInfo.queryCount = maxGpuZones * 2;
+    timestampPoolInfo.pipelineStatistics = 0;
+    VkQueryPoolCreateInfo statisticsPoolInfo = timestampPoolInfo;
+    statisticsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    statisticsPoolInfo.queryCount = maxGpuZones;
+    statisticsPoolInfo.pipelineStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    frames.resize(frameCount);
+    for (Frame& frame: frames)
+    {
+        VkResult result = vkCreateQueryPool(device, &timestampPoolInfo, allocator, &frame.timestampPool);
+        if (result != VK_SUCCESS)
+            throw std::runtime_error("failed to create timestamp query pool");
+        if (pipelineStatistics)
+        {
+            result = vkCreateQueryPool(device, &statisticsPoolInfo, allocator, &frame.statisticsPool);
+            if (result != VK_SUCCESS)
+                throw std::runtime_error("failed to create pipeline statistics query pool");
+        }
+        frame.zones.reserve(maxGpuZones);
+    }
+    calibrate();
+}
+
+void Profiler::destroyQueryPools()
+{
+    for (Frame& frame: frames)
+    {
+        vkDestroyQueryPool(device, frame.statisticsPool, allocator);
+        vkDestroyQueryPool(device, frame.timestampPool, allocator);
+    }
+    frames.clear();
+    currentFrame = nullptr;
+}
+
+void Profiler::setThreadName(const char *name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    threadNames.emplace_back((uint32_t)GetCurrentThreadId(), name);
+}
+
+void Profiler::beginFrame(VkCommandBuffer cmdBuffer, uint32_t frameIndex)
+{
+    if (frames.empty())
+        return;
+    currentFrame = &frames[frameIndex];
+    currentFrame->zones.clear();
+    currentFrame->timestampCount = 0;
+    currentFrame->statisticsCount = 0;
+    statisticsActive = false;
+    vkCmdResetQueryPool(cmdBuffer, currentFrame->timestampPool, 0, maxGpuZones * 2);
+    if (currentFrame->statisticsPool)
+        vkCmdResetQueryPool(cmdBuffer, currentFrame->statisticsPool, 0, maxGpuZones);
+}
+
+void Profiler::collect(uint32_t frameIndex)
+{
+    if (frames.empty())
+        return;
+    Frame& frame = frames[frameIndex];
+    if (frame.zones.empty())
+        return;
+    uint64_t timestamps[maxGpuZones * 2];
+    VkResult result = vkGetQueryPoolResults(device, frame.timestampPool, 0, frame.timestampCount,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+    {
+        frame.zones.clear();
+        return;
+    }
+    uint64_t statistics[maxGpuZones][statisticCount];
+    if (frame.statisticsCount)
+    {
+        result = vkGetQueryPoolResults(device, frame.statisticsPool, 0, frame.statisticsCount,
+            sizeof(statistics), statistics, sizeof(statistics[0]), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS)
+            frame.statisticsCount = 0;
+    }
+
+    uint64_t gpuBegin = ~0ull, gpuEnd = 0;
+    for (uint32_t i = 0; i < frame.timestampCount; ++i)
+    {
+        timestamps[i] &= timestampMask;
+        gpuBegin = std::min(gpuBegin, timestamps[i]);
+        gpuEnd = std::max(gpuEnd, timestamps[i]);
+    }
+    gpuFrameTime = (float)((gpuEnd - gpuBegin) * timestampPeriod * 1e-6);
+
+    uint64_t gpuBase;
+    int64_t cpuBase;
+    if (vkGetCalibratedTimestampsEXT)
+    {   // Re-calibrate once per second to compensate clock drift
+        if (now() - calibrationTicks > frequency)
+            calibrate();
+        gpuBase = gpuCalibrationTimestamp;
+        cpuBase = cpuCalibrationTicks;
+    }
+    else
+    {   // Without calibration, align the end of GPU work with fence completion
+        gpuBase = gpuEnd;
+        cpuBase = now();
+    }
+    auto toCpuTicks = [this, gpuBase, cpuBase](uint64_t timestamp) -> int64_t
+    {
+        const double nanoseconds = (double)(int64_t)(timestamp - gpuBase) * timestampPeriod;
+        return cpuBase + (int64_t)(nanoseconds * frequency * 1e-9);
+    };
+
+    for (const GpuZoneRecord& zone: frame.zones)
+    {
+        Event event;
+        event.name = zone.name;
+        event.threadId = GPU_THREAD_ID;
+        event.begin = toCpuTicks(timestamps[zone.beginQuery]);
+        event.end = toCpuTicks(timestamps[zone.endQuery]);
+        event.hasStatistics = (zone.statisticsQuery >= 0) && ((uint32_t)zone.statisticsQuery < frame.statisticsCount);
+        if (event.hasStatistics)
+            std::copy(statistics[zone.statisticsQuery], statistics[zone.statisticsQuery] + statisticCount, event.statistics);
+        addEvent(event);
+    }
+    frame.zones.clear();
+}
+
+bool Profiler::writeTrace(const char *fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file)
+        return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    char line[512];
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (auto const& thread: threadNames)
+    {
+        snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", thread.first, thread.second);
+        file << line;
+        first = false;
+    }
+    const double microseconds = 1e6 / frequency;
+    for (const Event& event: events)
+    {
+        snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+            event.name, (GPU_THREAD_ID == event.threadId) ? "gpu" : "cpu", event.threadId,
+            (event.begin - startTicks) * microseconds, std::max<int64_t>(event.end - event.begin, 0) * microseconds);
+        file << line;
+        if (event.hasStatistics)
+        {
+            file << ",\"args\":{";
+            for (uint32_t i = 0; i < statisticCount; ++i)
+            {
+                snprintf(line, sizeof(line), "%s\"%s\":%llu", i ? "," : "", statisticNames[i],
+                    (unsigned long long)event.statistics[i]);
+                file << line;
+            }
+            file << "}";
+        }
+        file << "}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return file.good();
+}
+
+int64_t Profiler::now()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+void Profiler::addEvent(const Event& event)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (events.size() < maxEvents)
+        events.push_back(event);
+}
+
+void Profiler::calibrate()
+{
+    calibrationTicks = now();
+    if (!vkGetCalibratedTimestampsEXT)
+        return;
+    VkCalibratedTimestampInfoEXT timestampInfos[2];
+    timestampInfos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    timestampInfos[0].pNext = nullptr;
+    timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    timestampInfos[1] = timestampInfos[0];
+    timestampInfos[1].timeDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+    uint64_t timestamps[2];
+    uint64_t maxDeviation;
+    VkResult result = vkGetCalibratedTimestampsEXT(device, 2, timestampInfos, timestamps, &maxDeviation);
+    if (VK_SUCCESS == result)
+    {
+        gpuCalibrationTimestamp = timestamps[0] & timestampMask;
+        cpuCalibrationTicks = (int64_t)timestamps[1];
+    }
+}
+
+int32_t Profiler::beginGpuZone(VkCommandBuffer cmdBuffer, const char *name)
+{
+    if (!currentFrame || (currentFrame->zones.size() >= maxGpuZones))
+        return -1;
+    GpuZoneRecord zone;
+    zone.name = name;
+    zone.beginQuery = currentFrame->timestampCount++;
+    zone.endQuery = currentFrame->timestampCount++;
+    zone.statisticsQuery = -1;
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, currentFrame->timestampPool, zone.beginQuery);
+    if (currentFrame->statisticsPool && !statisticsActive)
+    {   // Queries of the same type can't be nested, so only the outermost zone gets statistics
+        zone.statisticsQuery = (int32_t)currentFrame->statisticsCount++;
+        vkCmdBeginQuery(cmdBuffer, currentFrame->statisticsPool, zone.statisticsQuery, 0);
+        statisticsActive = true;
+    }
+    currentFrame->zones.push_back(zone);
+    return (int32_t)currentFrame->zones.size() - 1;
+}
+
+void Profiler::endGpuZone(VkCommandBuffer cmdBuffer, int32_t zoneIndex)
+{
+    if (zoneIndex < 0)
+        return;
+    const GpuZoneRecord& zone = currentFrame->zones[zoneIndex];
+    if (zone.statisticsQuery >= 0)
+    {
+        vkCmdEndQuery(cmdBuffer, currentFrame->statisticsPool, zone.statisticsQuery);
+        statisticsActive = false;
+    }
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, currentFrame->timestampPool, zone.endQuery);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Hierarchical CPU/GPU zone profiler. CPU zones are timed with the
+// performance counter, GPU zones with timestamp queries, one query pool
+// per frame in flight. GPU time is mapped to CPU time with
+// VK_EXT_calibrated_timestamps if available. Zones are written in
+// Chrome trace format, which can be opened in chrome://tracing or Perfetto.
+class Profiler
+{
+public:
+    class CpuZone
+    {
+    public:
+        CpuZone(Profiler& profiler, const char *name);
+        ~CpuZone();
+
+    private:
+        Profiler& profiler;
+        const char *name;
+        int64_t begin;
+    };
+
+    class GpuZone
+    {
+    public:
+        GpuZone(Profiler& profiler, VkCommandBuffer cmdBuffer, const char *name);
+        ~GpuZone();
+
+    private:
+        Profiler& profiler;
+        VkCommandBuffer cmdBuffer;
+        int32_t zoneIndex;
+    };
+
+    Profiler();
+    void createQueryPools(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t timestampValidBits,
+        uint32_t frameCount, bool calibratedTimestamps, bool pipelineStatistics,
+        const VkAllocationCallbacks *allocator);
+    void destroyQueryPools();
+    void setThreadName(const char *name);
+    void beginFrame(VkCommandBuffer cmdBuffer, uint32_t frameIndex);
+    void collect(uint32_t frameIndex);
+    bool writeTrace(const char *fileName) const;
+    float getGpuFrameTime() const { return gpuFrameTime; }
+
+private:
+    static constexpr uint32_t maxGpuZones = 64;
+    static constexpr uint32_t statisticCount = 5;
+    static constexpr size_t maxEvents = 1 << 20;
+
+    struct Event
+    {
+        const char *name;
+        uint32_t threadId;
+        int64_t begin, end;
+        bool hasStatistics;
+        uint64_t statistics[statisticCount];
+    };
+
+    struct GpuZoneRecord
+    {
+        const char *name;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+        int32_t statisticsQuery;
+    };
+
+    struct Frame
+    {
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+        std::vector<GpuZoneRecord> zones;
+        uint32_t timestampCount = 0;
+        uint32_t statisticsCount = 0;
+    };
+
+    static int64_t now();
+    void addEvent(const Event& event);
+    void calibrate();
+    int32_t beginGpuZone(VkCommandBuffer cmdBuffer, const char *name);
+    void endGpuZone(VkCommandBuffer cmdBuffer, int32_t zoneIndex);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks *allocator = nullptr;
+    PFN_vkGetCalibratedTimestampsEXT vkGetCalibratedTimestampsEXT = nullptr;
+    uint64_t timestampMask = 0;
+    double timestampPeriod = 1.; // Nanoseconds per tick
+    std::vector<Frame> frames;
+    Frame *currentFrame = nullptr;
+    bool statisticsActive = false;
+
+    int64_t frequency = 0;
+    int64_t startTicks = 0;
+    int64_t calibrationTicks = 0;
+    uint64_t gpuCalibrationTimestamp = 0;
+    int64_t cpuCalibrationTicks = 0;
+    float gpuFrameTime = 0.f;
+
+    mutable std::mutex mutex;
+    std::vector<Event> events;
+    std::vector<std::pair<uint32_t, const char *>> threadNames;
+};
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <stdexcept>
+#include "queueTopology.h"
+
+QueueTopology::QueueTopology(VkPhysicalDevice physicalDevice, const std::vector<VkSurfaceKHR>& surfaces, bool sparseBinding)
+{
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    familyProperties.resize(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, familyProperties.data());
+    priorities.resize(familyCount);
+
+    const uint32_t presentFamilyIndex = choosePresentFamily(physicalDevice, surfaces);
+    // Graphics family that presents itself saves a second queue in the frame
+    uint32_t graphicsFamilyIndex = presentFamilyIndex;
+    if ((VK_QUEUE_FAMILY_IGNORED == graphicsFamilyIndex) ||
+        !(familyProperties[graphicsFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+    {
+        graphicsFamilyIndex = chooseFamily(VK_QUEUE_GRAPHICS_BIT, 0);
+    }
+    if (VK_QUEUE_FAMILY_IGNORED == graphicsFamilyIndex)
+        throw std::runtime_error("no graphics queue family");
+    if (VK_QUEUE_FAMILY_IGNORED == presentFamilyIndex)
+        throw std::runtime_error("no queue family can present to all outputs");
+    assign(Graphics, graphicsFamilyIndex, graphicsPriority);
+    if (presentFamilyIndex == graphicsFamilyIndex)
+    {
+        assignments[Present] = assignments[Graphics];
+        assignments[Present].shared = assignments[Graphics].shared = true;
+    }
+    else
+        assign(Present, presentFamilyIndex, graphicsPriority);
+
+    // Dedicated families first: DMA engines for streaming, async compute
+    uint32_t familyIndex = chooseFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    if (VK_QUEUE_FAMILY_IGNORED == familyIndex)
+        familyIndex = chooseFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT);
+    if (VK_QUEUE_FAMILY_IGNORED == familyIndex)
+        familyIndex = graphicsFamilyIndex; // Graphics implies transfer
+    assign(Transfer, familyIndex, transferPriority);
+    familyIndex = chooseFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    if (VK_QUEUE_FAMILY_IGNORED == familyIndex)
+        familyIndex = graphicsFamilyIndex;
+    assign(Compute, familyIndex, computePriority);
+    if (sparseBinding)
+    {
+        familyIndex = chooseFamily(VK_QUEUE_SPARSE_BINDING_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+        if (VK_QUEUE_FAMILY_IGNORED == familyIndex)
+            familyIndex = chooseFamily(VK_QUEUE_SPARSE_BINDING_BIT, 0);
+        if (VK_QUEUE_FAMILY_IGNORED == familyIndex)
+            throw std::runtime_error("no sparse binding queue family");
+        assign(SparseBinding, familyIndex, sparseBindingPriority);
+    }
+    createQueueInfos();
+}
+
+VkQueue QueueTopology::getQueue(VkDevice device, Role role) const
+{
+    const Assignment& assignment = assignments[role];
+    if (VK_QUEUE_FAMILY_IGNORED == assignment.familyIndex)
+        return VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    vkGetDeviceQueue(device, assignment.familyIndex, assignment.queueIndex, &queue);
+    return queue;
+}
+
+const char *QueueTopology::getRoleName(Role role)
+{
+    switch (role)
+    {
+    case Graphics: return "graphics";
+    case Present: return "present";
+    case Transfer: return "transfer";
+    case Compute: return "compute";
+    case SparseBinding: return "sparse binding";
+    default: return "unknown";
+    }
+}
+
+uint32_t QueueTopology::chooseFamily(VkQueueFlags requiredFlags, VkQueueFlags avoidedFlags) const
+{
+    for (uint32_t i = 0; i < (uint32_t)familyProperties.size(); ++i)
+    {
+        const VkQueueFlags flags = familyProperties[i].queueFlags;
+        if (familyProperties[i].queueCount && ((flags & requiredFlags) == requiredFlags) && !(flags & avoidedFlags))
+            return i;
+    }
+    return VK_QUEUE_FAMILY_IGNORED;
+}
+
+uint32_t QueueTopology::choosePresentFamily(VkPhysicalDevice physicalDevice, const std::vector<VkSurfaceKHR>& surfaces) const
+{   // Single present covers all outputs, so one family has to support every surface.
+    // Graphics families are preferred, then whichever comes first.
+    uint32_t presentFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    for (uint32_t i = 0; i < (uint32_t)familyProperties.size(); ++i)
+    {
+        if (!familyProperties[i].queueCount)
+            continue;
+        bool supported = true;
+        for (VkSurfaceKHR surface: surfaces)
+        {
+            VkBool32 surfaceSupported = VK_FALSE;
+            const VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &surfaceSupported);
+            if ((VK_SUCCESS != result) || !surfaceSupported)
+            {
+                supported = false;
+                break;
+            }
+        }
+        if (!supported)
+            continue;
+        if (familyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            return i;
+        if (VK_QUEUE_FAMILY_IGNORED == presentFamilyIndex)
+            presentFamilyIndex = i;
+    }
+    return presentFamilyIndex;
+}
+
+void QueueTopology::assign(Role role, uint32_t familyIndex, float priority)
+{
+    Assignment& assignment = assignments[role];
+    std::vector<float>& familyPriorities = priorities[familyIndex];
+    assignment.familyIndex = familyIndex;
+    if (familyPriorities.size() < familyProperties[familyIndex].queueCount)
+    {
+        assignment.queueIndex = (uint32_t)familyPriorities.size();
+        assignment.priority = priority;
+        familyPriorities.push_back(priority);
+        return;
+    }
+    // Out of queues, share the last one at the higher of both priorities
+    assignment.queueIndex = (uint32_t)familyPriorities.size() - 1;
+    familyPriorities.back() = std::max(familyPriorities.back(), priority);
+    for (Assignment& other: assignments)
+    {
+        if ((other.familyIndex == familyIndex) && (other.queueIndex == assignment.queueIndex))
+        {
+            other.priority = familyPriorities.back();
+            other.shared = true;
+        }
+    }
+}
+
+void QueueTopology::createQueueInfos()
+{
+    for (uint32_t i = 0; i < (uint32_t)priorities.size(); ++i)
+    {
+        if (priorities[i].empty())
+            continue;
+        VkDeviceQueueCreateInfo queueInfo;
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.pNext = nullptr;
+        queueInfo.flags = 0;
+        queueInfo.queueFamilyIndex = i;
+        queueInfo.queueCount = (uint32_t)priorities[i].size();
+        queueInfo.pQueuePriorities = priorities[i].data();
+        queueCreateInfos.push_back(queueInfo);
+    }
+}
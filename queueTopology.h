@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Plans, before the device is created, which queue family and queue each
+// subsystem submits to. Every role gets a VkQueue of its own while its
+// family has queues left, so that work of unrelated subsystems isn't
+// serialized on a single queue; roles beyond the family's queueCount share
+// its last queue. Present goes to the graphics queue if its family can
+// present to every surface, otherwise to a queue of a family that can.
+class QueueTopology
+{
+public:
+    enum Role
+    {
+        Graphics,
+        Present,
+        Transfer, // Asset streaming
+        Compute,
+        SparseBinding,
+        RoleCount
+    };
+
+    struct Assignment
+    {
+        uint32_t familyIndex = VK_QUEUE_FAMILY_IGNORED; // Role is unused
+        uint32_t queueIndex = 0;
+        float priority = 0.f;
+        bool shared = false; // Same VkQueue as another role
+    };
+
+    QueueTopology(VkPhysicalDevice physicalDevice, const std::vector<VkSurfaceKHR>& surfaces, bool sparseBinding);
+    const std::vector<VkDeviceQueueCreateInfo>& getQueueCreateInfos() const { return queueCreateInfos; }
+    const Assignment& getAssignment(Role role) const { return assignments[role]; }
+    uint32_t getFamilyIndex(Role role) const { return assignments[role].familyIndex; }
+    VkQueue getQueue(VkDevice device, Role role) const;
+    static const char *getRoleName(Role role);
+
+private:
+    // Streaming yields to frame work where the implementation honors priorities
+    static constexpr float graphicsPriority = 1.f;
+    static constexpr float computePriority = 0.5f;
+    static constexpr float sparseBindingPriority = 0.5f;
+    static constexpr float transferPriority = 0.25f;
+
+    uint32_t chooseFamily(VkQueueFlags requiredFlags, VkQueueFlags avoidedFlags) const;
+    uint32_t choosePresentFamily(VkPhysicalDevice physicalDevice, const std::vector<VkSurfaceKHR>& surfaces) const;
+    void assign(Role role, uint32_t familyIndex, float priority);
+    void createQueueInfos();
+
+    std::vector<VkQueueFamilyProperties> familyProperties;
+    std::array<Assignment, RoleCount> assignments;
+    std::vector<std::vector<float>> priorities; // Of allocated queues per family
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+};
@@ -0,0 +1,42 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform FrameConstants
+{
+    float time; // Seconds
+    float deltaTime;
+    float resolutionScale;
+    uint frameIndex;
+    vec4 viewport; // Width, height, 1/width, 1/height
+};
+
+layout(location = 0) out vec4 color;
+
+float hash(vec2 p)
+{
+    return fract(sin(dot(p, vec2(127.1, 311.7))) * 43758.5453);
+}
+
+float noise(vec2 p)
+{
+    const vec2 i = floor(p);
+    const vec2 f = fract(p);
+    const vec2 u = f * f * (3.0 - 2.0 * f);
+    return mix(mix(hash(i), hash(i + vec2(1.0, 0.0)), u.x),
+        mix(hash(i + vec2(0.0, 1.0)), hash(i + vec2(1.0, 1.0)), u.x), u.y);
+}
+
+void main()
+{
+    const vec2 uv = gl_FragCoord.xy * viewport.zw;
+    vec2 p = uv * vec2(viewport.x * viewport.w, 1.0) * 3.0 + vec2(time * 0.05, 0.0);
+    float clouds = 0.0;
+    float amplitude = 0.5;
+    for (int octave = 0; octave < 6; ++octave)
+    {
+        clouds += noise(p) * amplitude;
+        p *= 2.0;
+        amplitude *= 0.5;
+    }
+    const vec3 sky = mix(vec3(0.35, 0.53, 0.7), vec3(0.12, 0.25, 0.5), uv.y);
+    color = vec4(mix(sky, vec3(1.0), smoothstep(0.45, 0.8, clouds) * (1.0 - uv.y)), 1.0);
+}
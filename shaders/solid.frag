@@ -0,0 +1,8 @@
+#version 450
+
+layout(location = 0) out vec4 color;
+
+void main()
+{   // Placeholder, cheap to compile
+    color = vec4(0.35, 0.53, 0.7, 1.0);
+}
@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include "submitQueue.h"
+
+SubmitQueue::SubmitQueue(VkDevice device_, bool synchronization2, Profiler& profiler_):
+    device(device_),
+    profiler(profiler_)
+{
+    if (synchronization2)
+        vkQueueSubmit2KHR = (PFN_vkQueueSubmit2KHR)vkGetDeviceProcAddr(device, "vkQueueSubmit2KHR");
+    thread = std::thread(&SubmitQueue::run, this);
+}
+
+SubmitQueue::~SubmitQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wakeUp.notify_one();
+    thread.join();
+}
+
+void SubmitQueue::submit(Batch&& batch)
+{
+    Item item;
+    item.type = Item::Submit;
+    item.batch = std::move(batch);
+    enqueue(std::move(item));
+}
+
+void SubmitQueue::present(Present&& present)
+{
+    Item item;
+    item.type = Item::Present;
+    item.present = std::move(present);
+    enqueue(std::move(item));
+}
+
+void SubmitQueue::bindSparse(BindSparse&& bindSparse)
+{
+    Item item;
+    item.type = Item::BindSparse;
+    item.bindSparse = std::move(bindSparse);
+    enqueue(std::move(item));
+}
+
+void SubmitQueue::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [this] { return items.empty() && !busy; });
+    lock.unlock();
+    checkError();
+}
+
+void SubmitQueue::waitForPresent()
+{   // Only presents are waited for, later submits may still be in flight
+    std::unique_lock<std::mutex> lock(mutex);
+    presented.wait(lock, [this] { return (presentDoneCount == presentRequestCount) || (error != VK_SUCCESS); });
+    lock.unlock();
+    checkError();
+}
+
+std::vector<SubmitQueue::PresentResult> SubmitQueue::getPresentResults() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return presentResults;
+}
+
+SubmitQueue::Statistics SubmitQueue::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Statistics statistics = stats;
+    if (stats.batchCount)
+        statistics.averageSubmitLatency = (float)(submitLatencySum / stats.batchCount);
+    if (stats.presentCount)
+        statistics.averagePresentLatency = (float)(presentLatencySum / stats.presentCount);
+    return statistics;
+}
+
+void SubmitQueue::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t queueDepth = stats.queueDepth;
+    stats = Statistics();
+    stats.queueDepth = queueDepth;
+    submitLatencySum = 0.;
+    presentLatencySum = 0.;
+}
+
+void SubmitQueue::enqueue(Item&& item)
+{
+    checkError();
+    item.enqueueTime = Clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (Item::Present == item.type)
+            ++presentRequestCount;
+        items.push_back(std::move(item));
+        stats.queueDepth = (uint32_t)items.size();
+        stats.maxQueueDepth = std::max(stats.maxQueueDepth, stats.queueDepth);
+    }
+    wakeUp.notify_one();
+}
+
+void SubmitQueue::checkError()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error != VK_SUCCESS)
+        throw std::runtime_error(errorMessage);
+}
+
+void SubmitQueue::run()
+{
+    profiler.setThreadName("submit");
+    std::vector<Item> pending;
+    std::vector<PresentResult> results;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            busy = false;
+            drained.notify_all();
+            wakeUp.wait(lock, [this] { return quit || !items.empty(); });
+            if (items.empty())
+                break;
+            pending.assign(std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+            items.clear();
+            stats.queueDepth = 0;
+            busy = true;
+            if (error != VK_SUCCESS)
+            {   // Drop work after a failure, producer will throw on the next call
+                pending.clear();
+                presentDoneCount = presentRequestCount;
+                presented.notify_all();
+                continue;
+            }
+        }
+        auto it = pending.cbegin();
+        while (it != pending.cend())
+        {
+            VkResult result;
+            auto end = it + 1;
+            results.clear();
+            if (Item::Present == it->type)
+            {
+                Profiler::CpuZone zone(profiler, "vkQueuePresentKHR");
+                result = queuePresent(it->present, results);
+            }
+            else if (Item::BindSparse == it->type)
+            {
+                Profiler::CpuZone zone(profiler, "vkQueueBindSparse");
+                result = queueBindSparse(it->bindSparse);
+            }
+            else
+            {   // Merge consecutive batches for the same queue, one fence per call
+                bool fence = (it->batch.fence != VK_NULL_HANDLE);
+                while ((end != pending.cend()) && (Item::Submit == end->type) && (end->batch.queue == it->batch.queue))
+                {
+                    if (end->batch.fence != VK_NULL_HANDLE)
+                    {
+                        if (fence)
+                            break;
+                        fence = true;
+                    }
+                    ++end;
+                }
+                Profiler::CpuZone zone(profiler, vkQueueSubmit2KHR ? "vkQueueSubmit2" : "vkQueueSubmit");
+                result = vkQueueSubmit2KHR ? queueSubmit2(it, end) : queueSubmit(it, end);
+            }
+            const Clock::time_point now = Clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (result != VK_SUCCESS)
+            {
+                error = result;
+                switch (it->type)
+                {
+                case Item::Present:
+                    errorMessage = "present failed";
+                    break;
+                case Item::BindSparse:
+                    errorMessage = "sparse binding failed";
+                    break;
+                default:
+                    errorMessage = "queue submission failed";
+                }
+                presented.notify_all();
+                break;
+            }
+            if (Item::Submit == it->type)
+                ++stats.submitCount;
+            else if (Item::Present == it->type)
+            {
+                presentResults.swap(results);
+                ++presentDoneCount;
+                presented.notify_all();
+            }
+            for (; it != end; ++it)
+                updateLatency(*it, now);
+        }
+        pending.clear();
+    }
+}
+
+VkResult SubmitQueue::queueSubmit(std::vector<Item>::const_iterator begin, std::vector<Item>::const_iterator end)
+{
+    VkFence fence = VK_NULL_HANDLE;
+    submitInfos.clear();
+    for (auto it = begin; it != end; ++it)
+    {
+        const Batch& batch = it->batch;
+        VkSubmitInfo submitInfo;
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = nullptr;
+        submitInfo.waitSemaphoreCount = (uint32_t)batch.waitSemaphores.size();
+        submitInfo.pWaitSemaphores = batch.waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = batch.waitDstStageMasks.data();
+        submitInfo.commandBufferCount = (uint32_t)batch.cmdBuffers.size();
+        submitInfo.pCommandBuffers = batch.cmdBuffers.data();
+        submitInfo.signalSemaphoreCount = (uint32_t)batch.signalSemaphores.size();
+        submitInfo.pSignalSemaphores = batch.signalSemaphores.data();
+        submitInfos.push_back(submitInfo);
+        if (batch.fence != VK_NULL_HANDLE)
+            fence = batch.fence;
+    }
+    return vkQueueSubmit(begin->batch.queue, (uint32_t)submitInfos.size(), submitInfos.data(), fence);
+}
+
+VkResult SubmitQueue::queueSubmit2(std::vector<Item>::const_iterator begin, std::vector<Item>::const_iterator end)
+{
+    size_t semaphoreCount = 0, cmdBufferCount = 0;
+    for (auto it = begin; it != end; ++it)
+    {
+        semaphoreCount += it->batch.waitSemaphores.size() + it->batch.signalSemaphores.size();
+        cmdBufferCount += it->batch.cmdBuffers.size();
+    }
+    // Reserve up front so that pointers into the arrays stay valid
+    semaphoreInfos.clear();
+    semaphoreInfos.reserve(semaphoreCount);
+    cmdBufferInfos.clear();
+    cmdBufferInfos.reserve(cmdBufferCount);
+    submitInfos2.clear();
+
+    VkFence fence = VK_NULL_HANDLE;
+    for (auto it = begin; it != end; ++it)
+    {
+        const Batch& batch = it->batch;
+        VkSemaphoreSubmitInfoKHR semaphoreInfo;
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+        semaphoreInfo.pNext = nullptr;
+        semaphoreInfo.value = 0;
+        semaphoreInfo.deviceIndex = 0;
+        VkCommandBufferSubmitInfoKHR cmdBufferInfo;
+        cmdBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+        cmdBufferInfo.pNext = nullptr;
+        cmdBufferInfo.deviceMask = 0;
+
+        VkSubmitInfo2KHR submitInfo;
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+        submitInfo.pNext = nullptr;
+        submitInfo.flags = 0;
+        submitInfo.waitSemaphoreInfoCount = (uint32_t)batch.waitSemaphores.size();
+        submitInfo.pWaitSemaphoreInfos = semaphoreInfos.data() + semaphoreInfos.size();
+        for (size_t i = 0; i < batch.waitSemaphores.size(); ++i)
+        {
+            semaphoreInfo.semaphore = batch.waitSemaphores[i];
+            semaphoreInfo.stageMask = batch.waitDstStageMasks[i];
+            semaphoreInfos.push_back(semaphoreInfo);
+        }
+        submitInfo.commandBufferInfoCount = (uint32_t)batch.cmdBuffers.size();
+        submitInfo.pCommandBufferInfos = cmdBufferInfos.data() + cmdBufferInfos.size();
+        for (VkCommandBuffer cmdBuffer: batch.cmdBuffers)
+        {
+            cmdBufferInfo.commandBuffer = cmdBuffer;
+            cmdBufferInfos.push_back(cmdBufferInfo);
+        }
+        submitInfo.signalSemaphoreInfoCount = (uint32_t)batch.signalSemaphores.size();
+        submitInfo.pSignalSemaphoreInfos = semaphoreInfos.data() + semaphoreInfos.size();
+        for (VkSemaphore semaphore: batch.signalSemaphores)
+        {
+            semaphoreInfo.semaphore = semaphore;
+            semaphoreInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+            semaphoreInfos.push_back(semaphoreInfo);
+        }
+        submitInfos2.push_back(submitInfo);
+        if (batch.fence != VK_NULL_HANDLE)
+            fence = batch.fence;
+    }
+    return vkQueueSubmit2KHR(begin->batch.queue, (uint32_t)submitInfos2.size(), submitInfos2.data(), fence);
+}
+
+VkResult SubmitQueue::queuePresent(const Present& present, std::vector<PresentResult>& results)
+{
+    const uint32_t swapchainCount = (uint32_t)present.swapchains.size();
+    swapchainResults.assign(swapchainCount, VK_SUCCESS);
+    VkPresentInfoKHR presentInfo;
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = nullptr;
+    presentInfo.waitSemaphoreCount = (uint32_t)present.waitSemaphores.size();
+    presentInfo.pWaitSemaphores = present.waitSemaphores.data();
+    presentInfo.swapchainCount = swapchainCount;
+    presentInfo.pSwapchains = present.swapchains.data();
+    presentInfo.pImageIndices = present.imageIndices.data();
+    presentInfo.pResults = swapchainResults.data();
+    VkResult result = vkQueuePresentKHR(present.queue, &presentInfo);
+    if (VK_SUBOPTIMAL_KHR == result)
+    {
+        OutputDebugStringA("suboptimal\n");
+        result = VK_SUCCESS;
+    }
+    else if (result != VK_SUCCESS && swapchainCount > 1)
+    {   // A lost or out-of-date output must not take the others down,
+        // owner inspects per-swapchain results and drops it
+        uint32_t failedCount = 0;
+        for (VkResult swapchainResult: swapchainResults)
+        {
+            switch (swapchainResult)
+            {
+            case VK_SUCCESS:
+            case VK_SUBOPTIMAL_KHR:
+                break;
+            case VK_ERROR_OUT_OF_DATE_KHR:
+            case VK_ERROR_SURFACE_LOST_KHR:
+                ++failedCount;
+                break;
+            default:
+                return swapchainResult;
+            }
+        }
+        if (failedCount < swapchainCount)
+            result = VK_SUCCESS;
+    }
+    for (uint32_t i = 0; i < swapchainCount; ++i)
+        results.push_back({present.swapchains[i], swapchainResults[i]});
+    return result;
+}
+
+VkResult SubmitQueue::queueBindSparse(const BindSparse& bindSparse)
+{
+    VkSparseImageOpaqueMemoryBindInfo opaqueBindInfo;
+    opaqueBindInfo.image = bindSparse.image;
+    opaqueBindInfo.bindCount = (uint32_t)bindSparse.opaqueBinds.size();
+    opaqueBindInfo.pBinds = bindSparse.opaqueBinds.data();
+    VkSparseImageMemoryBindInfo imageBindInfo;
+    imageBindInfo.image = bindSparse.image;
+    imageBindInfo.bindCount = (uint32_t)bindSparse.imageBinds.size();
+    imageBindInfo.pBinds = bindSparse.imageBinds.data();
+
+    VkBindSparseInfo bindSparseInfo;
+    bindSparseInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    bindSparseInfo.pNext = nullptr;
+    bindSparseInfo.waitSemaphoreCount = (uint32_t)bindSparse.waitSemaphores.size();
+    bindSparseInfo.pWaitSemaphores = bindSparse.waitSemaphores.data();
+    bindSparseInfo.bufferBindCount = 0;
+    bindSparseInfo.pBufferBinds = nullptr;
+    bindSparseInfo.imageOpaqueBindCount = bindSparse.opaqueBinds.empty() ? 0 : 1;
+    bindSparseInfo.pImageOpaqueBinds = &opaqueBindInfo;
+    bindSparseInfo.imageBindCount = bindSparse.imageBinds.empty() ? 0 : 1;
+    bindSparseInfo.pImageBinds = &imageBindInfo;
+    bindSparseInfo.signalSemaphoreCount = (uint32_t)bindSparse.signalSemaphores.size();
+    bindSparseInfo.pSignalSemaphores = bindSparse.signalSemaphores.data();
+    return vkQueueBindSparse(bindSparse.queue, 1, &bindSparseInfo, bindSparse.fence);
+}
+
+void SubmitQueue::updateLatency(const Item& item, Clock::time_point now)
+{
+    const std::chrono::microseconds us = std::chrono::duration_cast<std::chrono::microseconds>(now - item.enqueueTime);
+    const float latency = static_cast<float>(us.count()) * 0.001f;
+    if (Item::BindSparse == item.type)
+    {
+        ++stats.bindSparseCount;
+        return;
+    }
+    if (Item::Present == item.type)
+    {
+        ++stats.presentCount;
+        presentLatencySum += latency;
+        stats.maxPresentLatency = std::max(stats.maxPresentLatency, latency);
+    }
+    else
+    {
+        ++stats.batchCount;
+        submitLatencySum += latency;
+        stats.maxSubmitLatency = std::max(stats.maxSubmitLatency, latency);
+    }
+}
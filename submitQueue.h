@@ -0,0 +1,128 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "profiler.h"
+
+// Hands queue submissions, sparse binds and presents over to a dedicated
+// thread, so that driver submit cost comes off the recording thread.
+// Consecutive batches for the same queue are merged into a single
+// vkQueueSubmit2 call. The submit thread is the only one that touches
+// VkQueue objects; swapchains are shared with the producer, which has to
+// waitForPresent() before it acquires from them again.
+class SubmitQueue
+{
+public:
+    struct Batch
+    {
+        VkQueue queue = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> cmdBuffers;
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitDstStageMasks;
+        std::vector<VkSemaphore> signalSemaphores;
+        VkFence fence = VK_NULL_HANDLE;
+    };
+
+    struct Present
+    {
+        VkQueue queue = VK_NULL_HANDLE;
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkSwapchainKHR> swapchains;
+        std::vector<uint32_t> imageIndices;
+    };
+
+    struct PresentResult
+    {
+        VkSwapchainKHR swapchain;
+        VkResult result;
+    };
+
+    struct BindSparse
+    {
+        VkQueue queue = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+        std::vector<VkSparseMemoryBind> opaqueBinds;
+        std::vector<VkSparseImageMemoryBind> imageBinds;
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkSemaphore> signalSemaphores;
+        VkFence fence = VK_NULL_HANDLE;
+    };
+
+    struct Statistics
+    {
+        uint32_t queueDepth = 0;
+        uint32_t maxQueueDepth = 0;
+        uint64_t batchCount = 0;
+        uint64_t submitCount = 0;
+        uint64_t presentCount = 0;
+        uint64_t bindSparseCount = 0;
+        float averageSubmitLatency = 0.f; // Milliseconds from enqueue to driver return
+        float maxSubmitLatency = 0.f;
+        float averagePresentLatency = 0.f;
+        float maxPresentLatency = 0.f;
+    };
+
+    SubmitQueue(VkDevice device, bool synchronization2, Profiler& profiler);
+    ~SubmitQueue();
+    void submit(Batch&& batch);
+    void present(Present&& present);
+    void bindSparse(BindSparse&& bindSparse);
+    void flush();
+    void waitForPresent();
+    void checkError();
+    std::vector<PresentResult> getPresentResults() const;
+    Statistics getStatistics() const;
+    void resetStatistics();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Item
+    {
+        enum Type { Submit, Present, BindSparse } type;
+        SubmitQueue::Batch batch;
+        SubmitQueue::Present present;
+        SubmitQueue::BindSparse bindSparse;
+        Clock::time_point enqueueTime;
+    };
+
+    void enqueue(Item&& item);
+    void run();
+    VkResult queueSubmit(std::vector<Item>::const_iterator begin, std::vector<Item>::const_iterator end);
+    VkResult queueSubmit2(std::vector<Item>::const_iterator begin, std::vector<Item>::const_iterator end);
+    VkResult queuePresent(const Present& present, std::vector<PresentResult>& results);
+    VkResult queueBindSparse(const BindSparse& bindSparse);
+    void updateLatency(const Item& item, Clock::time_point now);
+
+    VkDevice device;
+    Profiler& profiler;
+    PFN_vkQueueSubmit2KHR vkQueueSubmit2KHR = nullptr;
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable drained;
+    std::condition_variable presented;
+    std::deque<Item> items;
+    bool busy = false;
+    uint64_t presentRequestCount = 0;
+    uint64_t presentDoneCount = 0; // Returned from vkQueuePresentKHR or dropped
+    bool quit = false;
+    VkResult error = VK_SUCCESS;
+    std::string errorMessage;
+
+    std::vector<VkSubmitInfo> submitInfos;
+    std::vector<VkSubmitInfo2KHR> submitInfos2;
+    std::vector<VkSemaphoreSubmitInfoKHR> semaphoreInfos;
+    std::vector<VkCommandBufferSubmitInfoKHR> cmdBufferInfos;
+    std::vector<VkResult> swapchainResults;
+    std::vector<PresentResult> presentResults; // Of the latest present, guarded by mutex
+
+    Statistics stats;
+    double submitLatencySum = 0.;
+    double presentLatencySum = 0.;
+};
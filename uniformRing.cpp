@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <stdexcept>
+#include "uniformRing.h"
+
+#define CHECK_SUCCEEDED(result, message)\
+    if (VK_SUCCESS != result)\
+        throw std::runtime_error(message)
+
+static VkDeviceSize alignUp(VkDeviceSize size, VkDeviceSize alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+UniformRing::UniformRing(VkPhysicalDevice physicalDevice_, VkDevice device_, HostAllocator& allocator_,
+    VkDeviceSize frameSize, uint32_t frameCount_, uint32_t bindingRange_):
+    physicalDevice(physicalDevice_),
+    device(device_),
+    allocator(allocator_),
+    frameCount(frameCount_)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, (VkDeviceSize)16);
+    bindingRange = std::min(bindingRange_, properties.limits.maxUniformBufferRange);
+    segmentSize = alignUp(frameSize, alignment);
+    stats.segmentSize = segmentSize;
+    createBuffer();
+    createDescriptorSet();
+}
+
+UniformRing::~UniformRing()
+{
+    vkDestroyDescriptorPool(device, descriptorPool, allocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, allocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+    vkDestroyBuffer(device, buffer, allocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+    if (memory)
+        vkUnmapMemory(device, memory);
+    vkFreeMemory(device, memory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex)
+{   // Caller has waited for the fence of the last submit that used this segment
+    stats.peakUsage = std::max(stats.peakUsage, head - segmentBegin);
+    stats.allocationCount = 0;
+    segmentBegin = (frameIndex % frameCount) * segmentSize;
+    head = segmentBegin;
+}
+
+UniformRing::Allocation UniformRing::allocate(VkDeviceSize size)
+{
+    if (size > bindingRange)
+        throw std::runtime_error("uniform allocation exceeds descriptor range");
+    const VkDeviceSize offset = alignUp(head, alignment);
+    if (offset + size > segmentBegin + segmentSize)
+        throw std::runtime_error("uniform ring segment overflow");
+    head = offset + size;
+    ++stats.allocationCount;
+    return Allocation{mappedData + offset, (uint32_t)offset};
+}
+
+void UniformRing::createBuffer()
+{
+    VkBufferCreateInfo bufferInfo;
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.flags = 0;
+    // Tail padding keeps dynamicOffset + range inside the buffer for the last allocation
+    bufferInfo.size = segmentSize * frameCount + bindingRange;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = 0;
+    bufferInfo.pQueueFamilyIndices = nullptr;
+    VkResult result = vkCreateBuffer(device, &bufferInfo, allocator.callbacks(VK_OBJECT_TYPE_BUFFER), &buffer);
+    CHECK_SUCCEEDED(result, "failed to create uniform buffer");
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+    const VkMemoryPropertyFlags hostFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    // Device local and host visible (resizable BAR) saves the GPU reads over the bus
+    uint32_t memoryTypeIndex = chooseMemoryType(memoryRequirements.memoryTypeBits, hostFlags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    stats.deviceLocal = (memoryTypeIndex != VK_MAX_MEMORY_TYPES);
+    if (!stats.deviceLocal)
+        memoryTypeIndex = chooseMemoryType(memoryRequirements.memoryTypeBits, hostFlags);
+    if (VK_MAX_MEMORY_TYPES == memoryTypeIndex)
+        throw std::runtime_error("failed to find host coherent memory type");
+
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = nullptr;
+    memoryAllocateInfo.allocationSize = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+    result = vkAllocateMemory(device, &memoryAllocateInfo, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &memory);
+    if ((VK_SUCCESS != result) && stats.deviceLocal)
+    {   // BAR heap is small, fall back to system memory
+        stats.deviceLocal = false;
+        memoryAllocateInfo.memoryTypeIndex = chooseMemoryType(memoryRequirements.memoryTypeBits, hostFlags);
+        result = vkAllocateMemory(device, &memoryAllocateInfo, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &memory);
+    }
+    CHECK_SUCCEEDED(result, "failed to allocate uniform buffer memory");
+    result = vkBindBufferMemory(device, buffer, memory, 0);
+    CHECK_SUCCEEDED(result, "failed to bind uniform buffer memory");
+    // Mapped for the lifetime of the buffer
+    result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, (void **)&mappedData);
+    CHECK_SUCCEEDED(result, "failed to map uniform buffer memory");
+}
+
+void UniformRing::createDescriptorSet()
+{
+    VkDescriptorSetLayoutBinding binding;
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_ALL;
+    binding.pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo;
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = nullptr;
+    layoutInfo.flags = 0;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo,
+        allocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &descriptorSetLayout);
+    CHECK_SUCCEEDED(result, "failed to create descriptor set layout");
+
+    VkDescriptorPoolSize poolSize;
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo;
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.pNext = nullptr;
+    poolInfo.flags = 0;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    result = vkCreateDescriptorPool(device, &poolInfo, allocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &descriptorPool);
+    CHECK_SUCCEEDED(result, "failed to create descriptor pool");
+
+    VkDescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.pNext = nullptr;
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &descriptorSetLayout;
+    result = vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
+    CHECK_SUCCEEDED(result, "failed to allocate descriptor set");
+
+    // Written once, allocations only change the dynamic offset
+    VkDescriptorBufferInfo bufferInfo;
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = bindingRange;
+
+    VkWriteDescriptorSet descriptorWrite;
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.pNext = nullptr;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrite.pImageInfo = nullptr;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    descriptorWrite.pTexelBufferView = nullptr;
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+uint32_t UniformRing::chooseMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const
+{
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        if ((memoryTypeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags))
+            return i;
+    }
+    return VK_MAX_MEMORY_TYPES;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstring>
+#include <vulkan/vulkan.h>
+#include "allocator.h"
+
+// Linear allocator for per-frame constants over one persistently mapped,
+// host-coherent uniform buffer. The buffer is split into one segment per
+// frame in flight; a segment is rewound by beginFrame() and must not be
+// reused before the fence of the submit that read it has signaled.
+// Allocations are addressed by dynamic offsets into a single
+// UNIFORM_BUFFER_DYNAMIC descriptor, so per-draw data costs a pointer
+// bump and a memcpy, without descriptor updates or vkMapMemory.
+class UniformRing
+{
+public:
+    struct Allocation
+    {
+        void *data;
+        uint32_t dynamicOffset;
+    };
+
+    struct Statistics
+    {
+        VkDeviceSize segmentSize = 0;
+        VkDeviceSize peakUsage = 0; // Bytes of a single frame
+        uint32_t allocationCount = 0; // Of the current frame
+        bool deviceLocal = false;
+    };
+
+    UniformRing(VkPhysicalDevice physicalDevice, VkDevice device, HostAllocator& allocator,
+        VkDeviceSize frameSize, uint32_t frameCount, uint32_t bindingRange);
+    ~UniformRing();
+    void beginFrame(uint32_t frameIndex);
+    Allocation allocate(VkDeviceSize size);
+    template<typename T>
+    uint32_t push(const T& data);
+    VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+    VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+    Statistics getStatistics() const { return stats; }
+
+private:
+    void createBuffer();
+    void createDescriptorSet();
+    uint32_t chooseMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const;
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    HostAllocator& allocator;
+    VkDeviceSize alignment; // minUniformBufferOffsetAlignment
+    VkDeviceSize segmentSize;
+    uint32_t frameCount;
+    uint32_t bindingRange;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint8_t *mappedData = nullptr;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkDeviceSize segmentBegin = 0;
+    VkDeviceSize head = 0; // Next free byte, from the beginning of the buffer
+    Statistics stats;
+};
+
+template<typename T>
+inline uint32_t UniformRing::push(const T& data)
+{
+    const Allocation allocation = allocate(sizeof(T));
+    memcpy(allocation.data, &data, sizeof(T));
+    return allocation.dynamicOffset;
+}
@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <stdexcept>
+#include "virtualTexture.h"
+
+#define CHECK_SUCCEEDED(result, message)\
+    if (VK_SUCCESS != result)\
+        throw std::runtime_error(message)
+
+static const uint32_t mipColors[] = {
+    0xFF4040E0, 0xFF40E040, 0xFFE04040, 0xFF40E0E0,
+    0xFFE040E0, 0xFFE0E040, 0xFF8080E0, 0xFF80E080
+};
+
+VirtualTexture::VirtualTexture(VkPhysicalDevice physicalDevice_, VkDevice device_, VkQueue sparseQueue_,
+    SubmitQueue& submitQueue_, HostAllocator& allocator_,
+    VkFormat format, uint32_t width, uint32_t height, VkDeviceSize memoryBudget):
+    physicalDevice(physicalDevice_),
+    device(device_),
+    sparseQueue(sparseQueue_),
+    submitQueue(submitQueue_),
+    allocator(allocator_)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    createImage(format, width, height);
+    createPagePool(memoryBudget);
+    createTiles();
+
+    void *data;
+    feedbackBuffer = createBuffer(std::max<VkDeviceSize>(tiles.size(), 1) * sizeof(uint32_t),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT, feedbackMemory, &data);
+    feedback = (const uint32_t *)data;
+
+    // Slot fits either a tile or the largest mip level of the mip tail
+    const VkExtent3D mipTailExtent = mipExtent(mipTailFirstLod);
+    uploadSlotSize = std::max<VkDeviceSize>(
+        tileExtent.width * tileExtent.height * texelSize,
+        (mipTailFirstLod < mipLevels) ? mipTailExtent.width * mipTailExtent.height * texelSize : 0);
+    uploadBuffer = createBuffer(uploadSlotSize * maxUploadsPerFrame, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, uploadMemory, &data);
+    uploadData = (uint8_t *)data;
+
+    VkSemaphoreCreateInfo semaphoreInfo;
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = nullptr;
+    semaphoreInfo.flags = 0;
+    VkResult result = vkCreateSemaphore(device, &semaphoreInfo, allocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &bindSemaphore);
+    CHECK_SUCCEEDED(result, "failed to create sparse binding semaphore");
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    vkDestroySemaphore(device, bindSemaphore, allocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+    vkDestroyBuffer(device, uploadBuffer, allocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+    vkDestroyBuffer(device, feedbackBuffer, allocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+    vkDestroyImageView(device, imageView, allocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+    vkDestroyImage(device, image, allocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+    vkFreeMemory(device, uploadMemory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    vkFreeMemory(device, feedbackMemory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    vkFreeMemory(device, mipTailMemory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    vkFreeMemory(device, pageMemory, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+}
+
+bool VirtualTexture::supported(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+    uint32_t propertyCount = 0;
+    vkGetPhysicalDeviceSparseImageFormatProperties(physicalDevice, format, VK_IMAGE_TYPE_2D,
+        VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_IMAGE_TILING_OPTIMAL, &propertyCount, nullptr);
+    return propertyCount > 0;
+}
+
+VkSemaphore VirtualTexture::update()
+{
+    ++frame;
+    uploads.clear();
+    stats.requestedTiles = 0;
+    stats.loadedTiles = 0;
+    stats.evictedTiles = 0;
+
+    SubmitQueue::BindSparse bindSparse;
+    bindSparse.queue = sparseQueue;
+    bindSparse.image = image;
+    if (!mipTailBound)
+    {   // Mip tail is bound and filled once, so that sampling always has a fallback
+        if (mipTailSize)
+        {
+            VkSparseMemoryBind mipTailBind;
+            mipTailBind.resourceOffset = mipTailOffset;
+            mipTailBind.size = mipTailSize;
+            mipTailBind.memory = mipTailMemory;
+            mipTailBind.memoryOffset = 0;
+            mipTailBind.flags = 0;
+            bindSparse.opaqueBinds.push_back(mipTailBind);
+        }
+        for (uint32_t mipLevel = mipTailFirstLod; mipLevel < mipLevels; ++mipLevel)
+        {
+            Upload upload = {mipLevel, VkOffset3D{0, 0, 0}, mipExtent(mipLevel), (uint32_t)uploads.size()};
+            generateTexels(upload.slot, upload.mipLevel, upload.offset, upload.extent);
+            uploads.push_back(upload);
+        }
+        mipTailBound = true;
+    }
+
+    // Feedback of the previous frame, which has completed by now
+    misses.clear();
+    if (feedbackRecorded)
+    {
+        for (uint32_t i = 0; i < (uint32_t)tiles.size(); ++i)
+        {
+            if (!feedback[i])
+                continue;
+            Tile& tile = tiles[i];
+            tile.lastRequested = frame;
+            ++stats.requestedTiles;
+            if (tile.page != nonResident)
+                lru.splice(lru.begin(), lru, tile.lru);
+            else
+                misses.push_back(i);
+        }
+        feedbackRecorded = false;
+    }
+
+    // Load coarser mips first, so that something sharper than the mip tail appears quickly
+    std::stable_sort(misses.begin(), misses.end(),
+        [this](uint32_t a, uint32_t b)
+        {
+            return tiles[a].mipLevel > tiles[b].mipLevel;
+        });
+    for (uint32_t tileIndex: misses)
+    {
+        if (uploads.size() >= maxUploadsPerFrame)
+            break;
+        uint32_t page;
+        if (!freePages.empty())
+        {
+            page = freePages.back();
+            freePages.pop_back();
+        }
+        else
+        {
+            const uint32_t victim = lru.back();
+            if (tiles[victim].lastRequested == frame)
+                break; // Budget is exhausted by visible tiles
+            page = tiles[victim].page;
+            evict(victim, bindSparse);
+        }
+        Tile& tile = tiles[tileIndex];
+        tile.page = page;
+        lru.push_front(tileIndex);
+        tile.lru = lru.begin();
+        bindSparse.imageBinds.push_back(tileBind(tile, pageMemory, page * pageSize));
+
+        const VkExtent3D mip = mipExtent(tile.mipLevel);
+        Upload upload;
+        upload.mipLevel = tile.mipLevel;
+        upload.offset = VkOffset3D{int32_t(tile.x * tileExtent.width), int32_t(tile.y * tileExtent.height), 0};
+        upload.extent = VkExtent3D{
+            std::min(tileExtent.width, mip.width - upload.offset.x),
+            std::min(tileExtent.height, mip.height - upload.offset.y),
+            1};
+        upload.slot = (uint32_t)uploads.size();
+        generateTexels(upload.slot, upload.mipLevel, upload.offset, upload.extent);
+        uploads.push_back(upload);
+        ++stats.loadedTiles;
+    }
+    stats.residentPages = stats.pageCount - (uint32_t)freePages.size();
+    stats.totalLoadedTiles += stats.loadedTiles;
+    stats.totalEvictedTiles += stats.evictedTiles;
+
+    if (bindSparse.opaqueBinds.empty() && bindSparse.imageBinds.empty())
+        return VK_NULL_HANDLE;
+    bindSparse.signalSemaphores.push_back(bindSemaphore);
+    submitQueue.bindSparse(std::move(bindSparse));
+    return bindSemaphore;
+}
+
+void VirtualTexture::recordUploads(VkCommandBuffer cmdBuffer)
+{
+    VkImageMemoryBarrier imageBarrier;
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.pNext = nullptr;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = mipLevels;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = 1;
+    if (!layoutInitialized)
+    {   // Image stays in general layout, so that copies and sampling don't need transitions
+        imageBarrier.srcAccessMask = 0;
+        imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &imageBarrier);
+        layoutInitialized = true;
+    }
+    if (uploads.empty())
+        return;
+
+    std::vector<VkBufferImageCopy> regions;
+    regions.reserve(uploads.size());
+    for (auto const& upload: uploads)
+    {
+        VkBufferImageCopy region;
+        region.bufferOffset = upload.slot * uploadSlotSize;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = upload.mipLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = upload.offset;
+        region.imageExtent = upload.extent;
+        regions.push_back(region);
+    }
+    vkCmdCopyBufferToImage(cmdBuffer, uploadBuffer, image, VK_IMAGE_LAYOUT_GENERAL, (uint32_t)regions.size(), regions.data());
+
+    imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
+void VirtualTexture::recordFeedback(VkCommandBuffer cmdBuffer, float u0, float v0, float u1, float v1, float lod)
+{   // Marks tiles of the sampled region, as the feedback write of a material shader would do
+    VkBufferMemoryBarrier bufferBarrier;
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.pNext = nullptr;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = feedbackBuffer;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    vkCmdFillBuffer(cmdBuffer, feedbackBuffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+    const uint32_t mipLevel = (uint32_t)std::max(lod, 0.f);
+    if (mipLevel < mipTailFirstLod)
+    {
+        const VkExtent3D mip = mipExtent(mipLevel);
+        const uint32_t tilesX = mipTilesX[mipLevel];
+        const uint32_t tilesY = (mip.height + tileExtent.height - 1) / tileExtent.height;
+        auto tileCoord = [](float coord, uint32_t size, uint32_t tileSize, uint32_t tileCount)
+        {
+            const uint32_t texel = (uint32_t)(std::min(std::max(coord, 0.f), 1.f) * (size - 1));
+            return std::min(texel / tileSize, tileCount - 1);
+        };
+        const uint32_t x0 = tileCoord(std::min(u0, u1), mip.width, tileExtent.width, tilesX);
+        const uint32_t x1 = tileCoord(std::max(u0, u1), mip.width, tileExtent.width, tilesX);
+        const uint32_t y0 = tileCoord(std::min(v0, v1), mip.height, tileExtent.height, tilesY);
+        const uint32_t y1 = tileCoord(std::max(v0, v1), mip.height, tileExtent.height, tilesY);
+        for (uint32_t y = y0; y <= y1; ++y)
+        {   // Tiles of a row are adjacent in the feedback buffer
+            const VkDeviceSize first = mipFirstTile[mipLevel] + y * tilesX + x0;
+            vkCmdFillBuffer(cmdBuffer, feedbackBuffer, first * sizeof(uint32_t), (x1 - x0 + 1) * sizeof(uint32_t), 1);
+        }
+    }
+
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr, 1, &bufferBarrier, 0, nullptr);
+    feedbackRecorded = true;
+}
+
+uint32_t VirtualTexture::chooseMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const
+{
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        if ((memoryTypeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags))
+            return i;
+    }
+    throw std::runtime_error("failed to find suitable memory type");
+}
+
+VkDeviceMemory VirtualTexture::allocateMemory(VkDeviceSize size, uint32_t memoryTypeBits, VkMemoryPropertyFlags flags)
+{
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = nullptr;
+    memoryAllocateInfo.allocationSize = size;
+    memoryAllocateInfo.memoryTypeIndex = chooseMemoryType(memoryTypeBits, flags);
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkResult result = vkAllocateMemory(device, &memoryAllocateInfo, allocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &memory);
+    CHECK_SUCCEEDED(result, "failed to allocate memory");
+    return memory;
+}
+
+VkBuffer VirtualTexture::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkDeviceMemory& memory, void **data)
+{
+    VkBufferCreateInfo bufferInfo;
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext = nullptr;
+    bufferInfo.flags = 0;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = 0;
+    bufferInfo.pQueueFamilyIndices = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkResult result = vkCreateBuffer(device, &bufferInfo, allocator.callbacks(VK_OBJECT_TYPE_BUFFER), &buffer);
+    CHECK_SUCCEEDED(result, "failed to create buffer");
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+    memory = allocateMemory(memoryRequirements.size, memoryRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    result = vkBindBufferMemory(device, buffer, memory, 0);
+    CHECK_SUCCEEDED(result, "failed to bind buffer memory");
+    result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, data);
+    CHECK_SUCCEEDED(result, "failed to map buffer memory");
+    return buffer;
+}
+
+void VirtualTexture::createImage(VkFormat format, uint32_t width, uint32_t height)
+{
+    extent = VkExtent3D{width, height, 1};
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        ++mipLevels;
+
+    VkImageCreateInfo imageInfo;
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.pNext = nullptr;
+    imageInfo.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = extent;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.queueFamilyIndexCount = 0;
+    imageInfo.pQueueFamilyIndices = nullptr;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult result = vkCreateImage(device, &imageInfo, allocator.callbacks(VK_OBJECT_TYPE_IMAGE), &image);
+    CHECK_SUCCEEDED(result, "failed to create sparse image");
+
+    // Sparse block size is the page size
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+    memoryTypeBits = memoryRequirements.memoryTypeBits;
+    pageSize = memoryRequirements.alignment;
+
+    uint32_t requirementCount = 0;
+    vkGetImageSparseMemoryRequirements(device, image, &requirementCount, nullptr);
+    std::vector<VkSparseImageMemoryRequirements> sparseRequirements(requirementCount);
+    vkGetImageSparseMemoryRequirements(device, image, &requirementCount, sparseRequirements.data());
+    auto it = std::find_if(sparseRequirements.begin(), sparseRequirements.end(),
+        [](auto const& requirements)
+        {
+            return requirements.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT;
+        });
+    if (it == sparseRequirements.end())
+        throw std::runtime_error("sparse image has no color aspect requirements");
+    tileExtent = it->formatProperties.imageGranularity;
+    mipTailFirstLod = std::min(it->imageMipTailFirstLod, mipLevels);
+    mipTailSize = it->imageMipTailSize;
+    mipTailOffset = it->imageMipTailOffset;
+
+    VkImageViewCreateInfo imageViewInfo;
+    imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewInfo.pNext = nullptr;
+    imageViewInfo.flags = 0;
+    imageViewInfo.image = image;
+    imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewInfo.format = format;
+    imageViewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageViewInfo.subresourceRange.baseMipLevel = 0;
+    imageViewInfo.subresourceRange.levelCount = mipLevels;
+    imageViewInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewInfo.subresourceRange.layerCount = 1;
+    result = vkCreateImageView(device, &imageViewInfo, allocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &imageView);
+    CHECK_SUCCEEDED(result, "failed to create sparse image view");
+}
+
+void VirtualTexture::createPagePool(VkDeviceSize memoryBudget)
+{   // Whole budget is allocated up front, binding only moves pages between tiles
+    const uint32_t pageCount = (uint32_t)(memoryBudget / pageSize);
+    if (!pageCount)
+        throw std::runtime_error("memory budget is less than sparse block size");
+    pageMemory = allocateMemory(pageCount * pageSize, memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (mipTailSize)
+        mipTailMemory = allocateMemory(mipTailSize, memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    freePages.resize(pageCount);
+    for (uint32_t i = 0; i < pageCount; ++i)
+        freePages[i] = pageCount - 1 - i;
+    stats.pageCount = pageCount;
+}
+
+void VirtualTexture::createTiles()
+{
+    for (uint32_t mipLevel = 0; mipLevel < mipTailFirstLod; ++mipLevel)
+    {
+        const VkExtent3D mip = mipExtent(mipLevel);
+        const uint32_t tilesX = (mip.width + tileExtent.width - 1) / tileExtent.width;
+        const uint32_t tilesY = (mip.height + tileExtent.height - 1) / tileExtent.height;
+        mipFirstTile.push_back((uint32_t)tiles.size());
+        mipTilesX.push_back(tilesX);
+        for (uint32_t y = 0; y < tilesY; ++y)
+        {
+            for (uint32_t x = 0; x < tilesX; ++x)
+            {
+                Tile tile;
+                tile.mipLevel = mipLevel;
+                tile.x = x;
+                tile.y = y;
+                tiles.push_back(tile);
+            }
+        }
+    }
+}
+
+VkSparseImageMemoryBind VirtualTexture::tileBind(const Tile& tile, VkDeviceMemory memory, VkDeviceSize offset) const
+{
+    const VkExtent3D mip = mipExtent(tile.mipLevel);
+    VkSparseImageMemoryBind bind;
+    bind.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    bind.subresource.mipLevel = tile.mipLevel;
+    bind.subresource.arrayLayer = 0;
+    bind.offset = VkOffset3D{int32_t(tile.x * tileExtent.width), int32_t(tile.y * tileExtent.height), 0};
+    bind.extent = VkExtent3D{ // Edge tiles may be partial
+        std::min(tileExtent.width, mip.width - tile.x * tileExtent.width),
+        std::min(tileExtent.height, mip.height - tile.y * tileExtent.height),
+        1};
+    bind.memory = memory;
+    bind.memoryOffset = offset;
+    bind.flags = 0;
+    return bind;
+}
+
+VkExtent3D VirtualTexture::mipExtent(uint32_t mipLevel) const
+{
+    return VkExtent3D{
+        std::max(extent.width >> mipLevel, 1u),
+        std::max(extent.height >> mipLevel, 1u),
+        1};
+}
+
+void VirtualTexture::generateTexels(uint32_t slot, uint32_t mipLevel, VkOffset3D offset, VkExtent3D size)
+{   // Stand-in for tile data streamed from disk: checkerboard tinted by mip level
+    uint32_t *texels = (uint32_t *)(uploadData + slot * uploadSlotSize);
+    const uint32_t color = mipColors[mipLevel % _countof(mipColors)];
+    const uint32_t darkColor = ((color >> 1) & 0x7F7F7F7F) | 0xFF000000;
+    for (uint32_t y = 0; y < size.height; ++y)
+    {
+        for (uint32_t x = 0; x < size.width; ++x)
+        {
+            const uint32_t checker = (((offset.x + x) >> 4) ^ ((offset.y + y) >> 4)) & 1;
+            *texels++ = checker ? color : darkColor;
+        }
+    }
+}
+
+void VirtualTexture::evict(uint32_t tileIndex, SubmitQueue::BindSparse& bindSparse)
+{
+    Tile& tile = tiles[tileIndex];
+    bindSparse.imageBinds.push_back(tileBind(tile, VK_NULL_HANDLE, 0));
+    lru.erase(tile.lru);
+    tile.page = nonResident;
+    ++stats.evictedTiles;
+}
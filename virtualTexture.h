@@ -0,0 +1,116 @@
+#pragma once
+#include <list>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "allocator.h"
+#include "submitQueue.h"
+
+// Sparse-resident virtual texture. Tiles requested by the feedback pass
+// are bound to pages of a fixed-size memory pool on the sparse binding
+// queue; when the pool is exhausted, the least recently requested tiles
+// are evicted. The mip tail is always resident.
+class VirtualTexture
+{
+public:
+    struct Statistics
+    {
+        uint32_t pageCount = 0;
+        uint32_t residentPages = 0;
+        uint32_t requestedTiles = 0; // Last frame
+        uint32_t loadedTiles = 0;
+        uint32_t evictedTiles = 0;
+        uint64_t totalLoadedTiles = 0;
+        uint64_t totalEvictedTiles = 0;
+    };
+
+    VirtualTexture(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue sparseQueue,
+        SubmitQueue& submitQueue, HostAllocator& allocator,
+        VkFormat format, uint32_t width, uint32_t height, VkDeviceSize memoryBudget);
+    ~VirtualTexture();
+    static bool supported(VkPhysicalDevice physicalDevice, VkFormat format);
+    VkSemaphore update();
+    void recordUploads(VkCommandBuffer cmdBuffer);
+    void recordFeedback(VkCommandBuffer cmdBuffer, float u0, float v0, float u1, float v1, float lod);
+    VkImage getImage() const { return image; }
+    VkImageView getImageView() const { return imageView; }
+    uint32_t getMipLevels() const { return mipLevels; }
+    Statistics getStatistics() const { return stats; }
+
+private:
+    static constexpr uint32_t maxUploadsPerFrame = 32;
+    static constexpr uint32_t texelSize = 4;
+    static constexpr uint32_t nonResident = ~0u;
+
+    struct Tile
+    {
+        uint32_t mipLevel;
+        uint32_t x, y;
+        uint32_t page = nonResident;
+        uint32_t lastRequested = 0;
+        std::list<uint32_t>::iterator lru;
+    };
+
+    struct Upload
+    {
+        uint32_t mipLevel;
+        VkOffset3D offset;
+        VkExtent3D extent;
+        uint32_t slot;
+    };
+
+    uint32_t chooseMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags flags) const;
+    VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryTypeBits, VkMemoryPropertyFlags flags);
+    VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkDeviceMemory& memory, void **data);
+    void createImage(VkFormat format, uint32_t width, uint32_t height);
+    void createPagePool(VkDeviceSize memoryBudget);
+    void createTiles();
+    VkSparseImageMemoryBind tileBind(const Tile& tile, VkDeviceMemory memory, VkDeviceSize offset) const;
+    VkExtent3D mipExtent(uint32_t mipLevel) const;
+    void generateTexels(uint32_t slot, uint32_t mipLevel, VkOffset3D offset, VkExtent3D size);
+    void evict(uint32_t tileIndex, SubmitQueue::BindSparse& bindSparse);
+
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue sparseQueue;
+    SubmitQueue& submitQueue;
+    HostAllocator& allocator;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkExtent3D extent;
+    uint32_t mipLevels = 1;
+    VkExtent3D tileExtent;
+    uint32_t mipTailFirstLod = 0;
+    VkDeviceSize mipTailSize = 0;
+    VkDeviceSize mipTailOffset = 0;
+    VkDeviceMemory mipTailMemory = VK_NULL_HANDLE;
+    bool mipTailBound = false;
+
+    uint32_t memoryTypeBits = 0;
+    VkDeviceSize pageSize = 0;
+    VkDeviceMemory pageMemory = VK_NULL_HANDLE;
+    std::vector<uint32_t> freePages;
+
+    std::vector<Tile> tiles;
+    std::vector<uint32_t> mipFirstTile;
+    std::vector<uint32_t> mipTilesX;
+    std::list<uint32_t> lru; // Most recently requested first
+
+    VkBuffer feedbackBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory feedbackMemory = VK_NULL_HANDLE;
+    const uint32_t *feedback = nullptr;
+    bool feedbackRecorded = false;
+
+    VkDeviceSize uploadSlotSize = 0;
+    VkBuffer uploadBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory uploadMemory = VK_NULL_HANDLE;
+    uint8_t *uploadData = nullptr;
+    std::vector<Upload> uploads;
+    std::vector<uint32_t> misses;
+
+    VkSemaphore bindSemaphore = VK_NULL_HANDLE;
+    bool layoutInitialized = false;
+    uint32_t frame = 0;
+    Statistics stats;
+};
@@ -1,8 +1,10 @@
 #include <array>
+#include <chrono>
 #include <string>
 #include <limits>
 #include <stdexcept>
 #include <cmath>
+#include <cstdio>
 #include <cassert>
 #include "vkApp.h"
 
@@ -10,6 +12,19 @@
 #define SCREEN_HEIGHT 1080
 #define MILLISECOND 1000000
 #define TIMEOUT 2 * MILLISECOND
+#define BENCHMARK_WARMUP_FRAMES 100
+#define VIRTUAL_TEXTURE_SIZE 16384
+#define VIRTUAL_TEXTURE_BUDGET (64ull * 1024 * 1024)
+#define VIRTUAL_TEXTURE_LOD 2.f
+#define MAX_OUTPUTS 4
+#define COMMAND_BUFFER_COUNT 2
+#define DYNAMIC_RESOLUTION_TARGET 16.667f // Milliseconds of GPU time
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.f
+#define UNIFORM_RING_FRAME_SIZE (256 * 1024) // Per frame in flight
+#define UNIFORM_RING_BINDING_RANGE 256 // Largest single allocation
+#define PIPELINE_LIST_FILE "pipelines.bin"
+#define RECREATE_ITERATIONS 100 // Benchmark of attachment recreation
 
 // Wait for fence, vkDeviceWaitIdle() is slower on Nvidia
 #define WAIT_PRESENT_FENCE
@@ -18,49 +33,100 @@
     if (VK_SUCCESS != result)\
         throw std::runtime_error(message)
 
+static bool parseDynamicResolution(const char *commandLine)
+{   // Render offscreen at a scale driven by GPU frame time and blit up to the swapchain
+    return commandLine && strstr(commandLine, "-dynamicresolution");
+}
+
+static bool parseDynamicRendering(const char *commandLine)
+{
+    return commandLine && strstr(commandLine, "-dynamicrendering");
+}
+
+static uint32_t parseOutputCount(const char *commandLine)
+{
+    const char *option = commandLine ? strstr(commandLine, "-outputs") : nullptr;
+    if (!option)
+        return 1;
+    const long outputCount = strtol(option + strlen("-outputs"), nullptr, 10);
+    return (uint32_t)std::min(std::max(outputCount, 1L), (long)MAX_OUTPUTS);
+}
+
 VkApp::VkApp(const Entry& entry, LPCTSTR caption, uint32_t width, uint32_t height):
     Win32App(entry, caption, width, height)
 {
+    dynamicRendering = parseDynamicRendering(entry.lpCmdLine);
     createInstance();
     createPhysicalDevice();
+    createOutputWindows(parseOutputCount(entry.lpCmdLine));
+    createWin32Surfaces(); // Queue topology depends on present support
     createLogicalDevice();
-    createWin32Surface();
-    createSwapchain();
+    createSwapchains();
+    createImageViews();
     createRenderPass();
-    createFramebuffer();
+    createFramebuffers();
     createCommandPools();
     createCommandBuffers();
     createSyncPrimitices();
+    createQueryPools();
+    createVirtualTexture();
+    createDynamicResolution(parseDynamicResolution(entry.lpCmdLine));
+    createUniformRing();
+    profiler.setThreadName("render");
+    const uint32_t benchmarkFrames = Benchmark::parseFrameCount(entry.lpCmdLine);
+    if (benchmarkFrames)
+        benchmark = std::make_unique<Benchmark>(BENCHMARK_WARMUP_FRAMES, benchmarkFrames);
+    createAssetPack(AssetPack::parseFileName(entry.lpCmdLine));
+    createPipelines(PipelineCompiler::parseWarmUp(entry.lpCmdLine));
+    if (benchmark)
+        measureRecreateLatency();
     timer.run();
 }
 
 VkApp::~VkApp()
 {
+    submitQueue.reset();
+    vkDeviceWaitIdle(device);
     for (auto fence: cmdSubmitFences)
-        vkDestroyFence(device, fence, nullptr);
-    vkDestroySemaphore(device, presentSemaphore, nullptr);
-    vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
+        vkDestroyFence(device, fence, allocator.callbacks(VK_OBJECT_TYPE_FENCE));
+    vkDestroySemaphore(device, renderFinishedSemaphore, allocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
     vkFreeCommandBuffers(device, transferCmdPool, 1, &transferCmdBuffer);
     vkFreeCommandBuffers(device, computeCmdPool, 1, &computeCmdBuffer);
     vkFreeCommandBuffers(device, graphicsCmdPool, (uint32_t)cmdBuffers.size(), cmdBuffers.data());
-    vkDestroyCommandPool(device, transferCmdPool, nullptr);
-    vkDestroyCommandPool(device, computeCmdPool, nullptr);
-    vkDestroyCommandPool(device, graphicsCmdPool, nullptr);
-    for (auto framebuffer: framebuffers)
-        vkDestroyFramebuffer(device, framebuffer, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
-    for (auto imageView: swapchainImageViews)
-        vkDestroyImageView(device, imageView, nullptr);
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
-    vkDestroyDevice(device, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    vkDestroyCommandPool(device, transferCmdPool, allocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+    vkDestroyCommandPool(device, computeCmdPool, allocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+    vkDestroyCommandPool(device, graphicsCmdPool, allocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+    destroyAttachments();
+    for (auto const& output: outputs)
+    {
+        vkDestroySwapchainKHR(device, output.swapchain, allocator.callbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
+        vkDestroySemaphore(device, output.acquireSemaphore, allocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+    }
+    if (pipelineCompiler)
+    {   // Recorded for the next -warmup run; joins workers that may still use the render pass
+        pipelineCompiler->writePipelineList(PIPELINE_LIST_FILE);
+        pipelineCompiler.reset();
+    }
+    vkDestroyRenderPass(device, renderPass, allocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
+    virtualTexture.reset();
+    dynamicResolution.reset();
+    assetPack.reset();
+    vkDestroyPipelineLayout(device, pipelineLayout, allocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+    uniformRing.reset();
+    profiler.destroyQueryPools();
+    vkDestroyDevice(device, allocator.callbacks(VK_OBJECT_TYPE_DEVICE));
+    for (auto const& output: outputs)
+        vkDestroySurfaceKHR(instance, output.surface, allocator.callbacks(VK_OBJECT_TYPE_SURFACE_KHR));
 #ifdef _DEBUG
     PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)
         vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
     if (vkDestroyDebugReportCallbackEXT)
-        vkDestroyDebugReportCallbackEXT(instance, debugReportCallback, nullptr);
+        vkDestroyDebugReportCallbackEXT(instance, debugReportCallback,
+            allocator.callbacks(VK_OBJECT_TYPE_DEBUG_REPORT_CALLBACK_EXT));
 #endif // _DEBUG
-    vkDestroyInstance(instance, nullptr);
+    vkDestroyInstance(instance, allocator.callbacks(VK_OBJECT_TYPE_INSTANCE));
+    allocator.dumpStatistics();
+    profiler.writeTrace("trace.json");
 }
 
 void VkApp::close()
@@ -71,13 +137,36 @@ void VkApp::close()
 void VkApp::onIdle()
 {
     onPaint();
+    if (benchmark && !benchmark->nextFrame())
+    {
+        benchmark->writeReport("benchmark.txt");
+        benchmark.reset();
+        close();
+    }
 }
 
 void VkApp::onPaint()
 {
-    const uint32_t imageIndex = aquireNextImage();
-    VkFramebuffer framebuffer = framebuffers[imageIndex];
-    VkCommandBuffer cmdBuffer = cmdBuffers[imageIndex];
+    Profiler::CpuZone frameZone(profiler, "frame");
+    Benchmark::Timing frameTiming(benchmark.get(), Benchmark::Paint);
+    // Swapchains are externally synchronized, present of the last frame has to return first
+    submitQueue->waitForPresent();
+    checkPresentResults();
+    {   // All outputs are acquired up front, so that they share one submit and one present
+        Profiler::CpuZone zone(profiler, "acquire");
+        Benchmark::Timing timing(benchmark.get(), Benchmark::Acquire);
+        aquireNextImages();
+    }
+    VkSemaphore bindSemaphore = VK_NULL_HANDLE;
+    if (virtualTexture)
+    {
+        Profiler::CpuZone zone(profiler, "virtual texture update");
+        bindSemaphore = virtualTexture->update();
+    }
+    if (dynamicResolution)
+        dynamicResolution->update(profiler.getGpuFrameTime());
+    updateFrameConstants();
+    VkCommandBuffer cmdBuffer = cmdBuffers[frameIndex];
 
     VkCommandBufferBeginInfo cmdBufferBeginInfo;
     cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -85,48 +174,129 @@ void VkApp::onPaint()
     cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     cmdBufferBeginInfo.pInheritanceInfo = nullptr;
 
-    vkResetCommandBuffer(cmdBuffer, 0);
-    VkResult result = vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
-    assert(VK_SUCCESS == result);
-    if (VK_SUCCESS == result)
-    {
-        std::array<VkClearValue, 2> clearValues;
-        clearValues[0].color = {0.35f, 0.53f, 0.7f, 1.f};
-        clearValues[1].depthStencil = {1.f, 0};
-
-        VkRenderPassBeginInfo renderPassBeginInfo;
-        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassBeginInfo.pNext = nullptr;
-        renderPassBeginInfo.renderPass = renderPass;
-        renderPassBeginInfo.framebuffer = framebuffer;
-        renderPassBeginInfo.renderArea.offset = VkOffset2D{0, 0};
-        renderPassBeginInfo.renderArea.extent = VkExtent2D{width, height};
-        renderPassBeginInfo.clearValueCount = (uint32_t)clearValues.size();
-        renderPassBeginInfo.pClearValues = clearValues.data();
-
-        vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    {
+        Profiler::CpuZone zone(profiler, "record");
+        Benchmark::Timing timing(benchmark.get(), Benchmark::Record);
+        vkResetCommandBuffer(cmdBuffer, 0);
+        VkResult result = vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
+        assert(VK_SUCCESS == result);
+        if (VK_SUCCESS == result)
         {
-            // Empty
+            profiler.beginFrame(cmdBuffer, frameIndex);
+            if (virtualTexture)
+            {   // Feedback region pans across the virtual texture
+                Profiler::GpuZone gpuZone(profiler, cmdBuffer, "virtual texture");
+                virtualTexture->recordUploads(cmdBuffer);
+                const float u = 0.5f + 0.4f * std::cos(panAngle);
+                const float v = 0.5f + 0.4f * std::sin(panAngle);
+                virtualTexture->recordFeedback(cmdBuffer, u - 0.05f, v - 0.05f, u + 0.05f, v + 0.05f, VIRTUAL_TEXTURE_LOD);
+            }
+            std::array<VkClearValue, 2> clearValues;
+            clearValues[0].color = {0.35f, 0.53f, 0.7f, 1.f};
+            clearValues[1].depthStencil = {1.f, 0};
+
+            VkRenderPassBeginInfo renderPassBeginInfo;
+            renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassBeginInfo.pNext = nullptr;
+            renderPassBeginInfo.renderPass = renderPass;
+            //renderPassBeginInfo.framebuffer = ;
+            renderPassBeginInfo.renderArea.offset = VkOffset2D{0, 0};
+            renderPassBeginInfo.renderArea.extent = VkExtent2D{width, height};
+            renderPassBeginInfo.clearValueCount = (uint32_t)clearValues.size();
+            renderPassBeginInfo.pClearValues = clearValues.data();
+
+            if (dynamicResolution)
+            {   // Render once at reduced resolution, then upscale to every output
+                renderPassBeginInfo.renderPass = dynamicResolution->getRenderPass();
+                renderPassBeginInfo.framebuffer = dynamicResolution->getFramebuffer();
+                renderPassBeginInfo.renderArea.extent = dynamicResolution->getRenderExtent();
+                {
+                    Profiler::GpuZone gpuZone(profiler, cmdBuffer, "render pass");
+                    if (dynamicRendering)
+                    {
+                        recordRendering(cmdBuffer, dynamicResolution->getImage(), dynamicResolution->getImageView(),
+                            renderPassBeginInfo.renderArea.extent, clearValues[0], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+                    }
+                    else
+                    {
+                        vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                        draw(cmdBuffer, renderPassBeginInfo.renderArea.extent);
+                        vkCmdEndRenderPass(cmdBuffer);
+                    }
+                }
+                Profiler::GpuZone gpuZone(profiler, cmdBuffer, "upscale");
+                for (auto const& output: outputs)
+                {
+                    if (output.active)
+                        dynamicResolution->recordUpscale(cmdBuffer, output.images[output.imageIndex], VkExtent2D{width, height});
+                }
+            }
+            else
+            {
+                for (auto const& output: outputs)
+                {   // Outputs share one command buffer, a render pass per swapchain image
+                    if (!output.active)
+                        continue;
+                    Profiler::GpuZone gpuZone(profiler, cmdBuffer, "render pass");
+                    if (dynamicRendering)
+                    {
+                        recordRendering(cmdBuffer, output.images[output.imageIndex], output.imageViews[output.imageIndex],
+                            renderPassBeginInfo.renderArea.extent, clearValues[0], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+                        continue;
+                    }
+                    renderPassBeginInfo.framebuffer = output.framebuffers[output.imageIndex];
+                    vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                    draw(cmdBuffer, renderPassBeginInfo.renderArea.extent);
+                    vkCmdEndRenderPass(cmdBuffer);
+                }
+            }
         }
-        vkCmdEndRenderPass(cmdBuffer);
+        vkEndCommandBuffer(cmdBuffer);
     }
-    vkEndCommandBuffer(cmdBuffer);
-
-    submit(imageIndex);
-    present(imageIndex);
-    waitForPresentComplete(imageIndex);
+    {
+        Profiler::CpuZone zone(profiler, "submit");
+        Benchmark::Timing timing(benchmark.get(), Benchmark::Submit);
+        submit(bindSemaphore);
+    }
+    {
+        Profiler::CpuZone zone(profiler, "present");
+        Benchmark::Timing timing(benchmark.get(), Benchmark::Present);
+        present();
+    }
+    {
+        Profiler::CpuZone zone(profiler, "fence wait");
+        Benchmark::Timing timing(benchmark.get(), Benchmark::WaitForPresent);
+        waitForPresentComplete();
+    }
+    profiler.collect(frameIndex);
+    frameIndex = (frameIndex + 1) % (uint32_t)cmdBuffers.size();
 
     ++frameCount;
     float dt = timer.millisecondsElapsed();
+    deltaTime = dt;
+    elapsedTime += dt / 1000.f;
     time += dt;
+    panAngle += 0.0002f * dt;
     if (time > 1000.f)
     {
         fps = (uint32_t)(std::roundf(frameCount * (time / 1000.f)));
         time = 0.f;
         frameCount = 0;
 
-        const std::string caption = "FPS: " + std::to_string(fps);
-        SetWindowText(hWnd, caption.c_str());
+        const SubmitQueue::Statistics stats = submitQueue->getStatistics();
+        submitQueue->resetStatistics();
+        char caption[192];
+        int length = snprintf(caption, sizeof(caption), "FPS: %u, submit: %.3f ms, present: %.3f ms, queue depth: %u",
+            fps, stats.averageSubmitLatency, stats.averagePresentLatency, stats.maxQueueDepth);
+        if (virtualTexture)
+        {
+            const VirtualTexture::Statistics textureStats = virtualTexture->getStatistics();
+            length += snprintf(caption + length, sizeof(caption) - length, ", resident pages: %u/%u",
+                textureStats.residentPages, textureStats.pageCount);
+        }
+        if (dynamicResolution)
+            snprintf(caption + length, sizeof(caption) - length, ", scale: %.2f", dynamicResolution->getScale());
+        SetWindowText(hWnd, caption);
     }
 }
 
@@ -179,7 +349,7 @@ void VkApp::createInstance()
     instanceInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
     instanceInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
-    VkResult result = vkCreateInstance(&instanceInfo, nullptr, &instance);
+    VkResult result = vkCreateInstance(&instanceInfo, allocator.callbacks(VK_OBJECT_TYPE_INSTANCE), &instance);
     CHECK_SUCCEEDED(result, "failed to create Vulkan instance");
 #ifdef _DEBUG
     PFN_vkCreateDebugReportCallbackEXT vkCreateDebugReportCallbackEXT =
@@ -197,7 +367,8 @@ void VkApp::createInstance()
             VK_DEBUG_REPORT_DEBUG_BIT_EXT;
         debugReportCallbackInfo.pfnCallback = debugCallback;
         debugReportCallbackInfo.pUserData = nullptr;
-        VkResult result = vkCreateDebugReportCallbackEXT(instance, &debugReportCallbackInfo, nullptr, &debugReportCallback);
+        VkResult result = vkCreateDebugReportCallbackEXT(instance, &debugReportCallbackInfo,
+            allocator.callbacks(VK_OBJECT_TYPE_DEBUG_REPORT_CALLBACK_EXT), &debugReportCallback);
         CHECK_SUCCEEDED(result, "failed to create debug report callback");
     }
 #endif // _DEBUG
@@ -229,7 +400,6 @@ void VkApp::createLogicalDevice()
         VK_KHR_MAINTENANCE1_EXTENSION_NAME,
     };
 
-#ifdef _DEBUG
     uint32_t propertyCount = 0;
     vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &propertyCount, nullptr);
     if (propertyCount)
@@ -237,6 +407,7 @@ void VkApp::createLogicalDevice()
         extensionProperties.resize(propertyCount);
         vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &propertyCount, extensionProperties.data());
     }
+#ifdef _DEBUG
     for (const char *extensionName: enabledExtensions)
     {
         if (!findExtension(extensionName))
@@ -247,31 +418,110 @@ void VkApp::createLogicalDevice()
     }
 #endif // _DEBUG
 
-    const float defaultQueuePriorities[1] = {1.f};
-
-    VkDeviceQueueCreateInfo graphicsQueueInfo, computeQueueInfo, transferQueueInfo;
-    graphicsQueueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    graphicsQueueInfo.pNext = nullptr;
-    graphicsQueueInfo.flags = 0;
-    graphicsQueueInfo.queueFamilyIndex = chooseFamilyIndex(VK_QUEUE_GRAPHICS_BIT);
-    graphicsQueueInfo.queueCount = 1;
-    graphicsQueueInfo.pQueuePriorities = defaultQueuePriorities;
-    computeQueueInfo = graphicsQueueInfo;
-    computeQueueInfo.queueFamilyIndex = chooseFamilyIndex(VK_QUEUE_COMPUTE_BIT);
-    transferQueueInfo = graphicsQueueInfo;
-    transferQueueInfo.queueFamilyIndex = chooseFamilyIndex(VK_QUEUE_TRANSFER_BIT);
-
-    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    queueCreateInfos.push_back(graphicsQueueInfo);
-    if (computeQueueInfo.queueFamilyIndex != graphicsQueueInfo.queueFamilyIndex)
-        queueCreateInfos.push_back(computeQueueInfo);
-    if ((transferQueueInfo.queueFamilyIndex != graphicsQueueInfo.queueFamilyIndex) &&
-        (transferQueueInfo.queueFamilyIndex != computeQueueInfo.queueFamilyIndex))
-        queueCreateInfos.push_back(transferQueueInfo);
+    // Submit thread uses vkQueueSubmit2 if available
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features;
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    synchronization2Features.pNext = nullptr;
+    synchronization2Features.synchronization2 = VK_FALSE;
+    // Alternative to render pass and framebuffer objects, if selected on the command line.
+    // Vulkan 1.1 device also needs the extensions it depends on.
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures;
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    dynamicRenderingFeatures.pNext = nullptr;
+    dynamicRenderingFeatures.dynamicRendering = VK_FALSE;
+    const bool dynamicRenderingExtensions = findExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+        findExtension(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+        findExtension(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+    VkPhysicalDeviceFeatures2 features;
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = nullptr;
+    if (findExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME))
+    {
+        synchronization2Features.pNext = features.pNext;
+        features.pNext = &synchronization2Features;
+    }
+    if (dynamicRendering && dynamicRenderingExtensions)
+    {
+        dynamicRenderingFeatures.pNext = features.pNext;
+        features.pNext = &dynamicRenderingFeatures;
+    }
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    void *deviceFeatures = nullptr;
+    if (synchronization2Features.synchronization2)
+    {
+        enabledExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        synchronization2Features.pNext = deviceFeatures;
+        deviceFeatures = &synchronization2Features;
+    }
+    if (dynamicRenderingFeatures.dynamicRendering)
+    {
+        enabledExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+        enabledExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+        enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        dynamicRenderingFeatures.pNext = deviceFeatures;
+        deviceFeatures = &dynamicRenderingFeatures;
+    }
+    else if (dynamicRendering)
+    {
+        OutputDebugStringA("dynamic rendering not supported, using render pass\n");
+        dynamicRendering = false;
+    }
+    enabledFeatures.pipelineStatisticsQuery = features.features.pipelineStatisticsQuery;
+    // Virtual texture needs sparse residency of 2D images
+    if (features.features.sparseBinding && features.features.sparseResidencyImage2D)
+    {
+        enabledFeatures.sparseBinding = VK_TRUE;
+        enabledFeatures.sparseResidencyImage2D = VK_TRUE;
+    }
+
+    // Asset pack imports its file mapping as host memory
+    if (findExtension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
+    {
+        enabledExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+        externalMemoryHost = true;
+    }
+
+    // Profiler maps GPU timestamps to performance counter ticks
+    if (findExtension(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME))
+    {
+        PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT vkGetPhysicalDeviceCalibrateableTimeDomainsEXT =
+            (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+        uint32_t timeDomainCount = 0;
+        if (vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+            vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &timeDomainCount, nullptr);
+        std::vector<VkTimeDomainEXT> timeDomains(timeDomainCount);
+        if (timeDomainCount)
+            vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &timeDomainCount, timeDomains.data());
+        const bool hasDevice = std::find(timeDomains.begin(), timeDomains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != timeDomains.end();
+        const bool hasPerformanceCounter = std::find(timeDomains.begin(), timeDomains.end(), VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT) != timeDomains.end();
+        if (hasDevice && hasPerformanceCounter)
+        {
+            enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+            calibratedTimestamps = true;
+        }
+    }
+
+    std::vector<VkSurfaceKHR> surfaces;
+    for (auto const& output: outputs)
+        surfaces.push_back(output.surface);
+    queueTopology = std::make_unique<QueueTopology>(physicalDevice, surfaces, enabledFeatures.sparseBinding != VK_FALSE);
+    const std::vector<VkDeviceQueueCreateInfo>& queueCreateInfos = queueTopology->getQueueCreateInfos();
+    for (uint32_t i = 0; i < QueueTopology::RoleCount; ++i)
+    {
+        const QueueTopology::Role role = (QueueTopology::Role)i;
+        const QueueTopology::Assignment& assignment = queueTopology->getAssignment(role);
+        if (VK_QUEUE_FAMILY_IGNORED == assignment.familyIndex)
+            continue;
+        char message[128];
+        snprintf(message, sizeof(message), "%s queue: family %u, index %u, priority %.2f%s\n",
+            QueueTopology::getRoleName(role), assignment.familyIndex, assignment.queueIndex,
+            assignment.priority, assignment.shared ? ", shared" : "");
+        OutputDebugStringA(message);
+    }
 
     VkDeviceCreateInfo deviceInfo;
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceInfo.pNext = nullptr;
+    deviceInfo.pNext = deviceFeatures;
     deviceInfo.flags = 0;
     deviceInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
     deviceInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -279,60 +529,114 @@ void VkApp::createLogicalDevice()
     deviceInfo.ppEnabledLayerNames = nullptr;
     deviceInfo.enabledExtensionCount = (uint32_t)enabledExtensions.size();
     deviceInfo.ppEnabledExtensionNames = enabledExtensions.data();
-    deviceInfo.pEnabledFeatures = nullptr;
-    VkResult result = vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device);
+    deviceInfo.pEnabledFeatures = &enabledFeatures;
+    VkResult result = vkCreateDevice(physicalDevice, &deviceInfo, allocator.callbacks(VK_OBJECT_TYPE_DEVICE), &device);
     if (VK_ERROR_EXTENSION_NOT_PRESENT == result)
         throw std::runtime_error("required extension not present");
     CHECK_SUCCEEDED(result, "failed to create device");
 
-    vkGetDeviceQueue(device, graphicsQueueInfo.queueFamilyIndex, 0, &graphicsQueue);
-    vkGetDeviceQueue(device, computeQueueInfo.queueFamilyIndex, 0, &computeQueue);
-    vkGetDeviceQueue(device, transferQueueInfo.queueFamilyIndex, 0, &transferQueue);
+    graphicsQueue = queueTopology->getQueue(device, QueueTopology::Graphics);
+    presentQueue = queueTopology->getQueue(device, QueueTopology::Present);
+    computeQueue = queueTopology->getQueue(device, QueueTopology::Compute);
+    transferQueue = queueTopology->getQueue(device, QueueTopology::Transfer);
+    sparseQueue = queueTopology->getQueue(device, QueueTopology::SparseBinding);
+    submitQueue = std::make_unique<SubmitQueue>(device, synchronization2Features.synchronization2 != VK_FALSE, profiler);
+    if (dynamicRendering)
+    {
+        vkCmdBeginRenderingKHR = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        vkCmdEndRenderingKHR = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+    }
 }
 
-void VkApp::createWin32Surface()
+void VkApp::createOutputWindows(uint32_t outputCount)
+{
+    outputs.resize(outputCount);
+    outputs[0].hWnd = hWnd;
+    for (uint32_t i = 1; i < outputCount; ++i)
+    {
+        char caption[32];
+        snprintf(caption, sizeof(caption), "Vulkan output %u", i);
+        outputs[i].hWnd = addWindow(caption);
+    }
+}
+
+void VkApp::createWin32Surfaces()
 {
     VkWin32SurfaceCreateInfoKHR surfaceInfo;
     surfaceInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
     surfaceInfo.pNext = nullptr;
     surfaceInfo.flags = 0;
     surfaceInfo.hinstance = hInstance;
-    surfaceInfo.hwnd = hWnd;
-    VkResult result = vkCreateWin32SurfaceKHR(instance, &surfaceInfo, nullptr, &surface);
-    CHECK_SUCCEEDED(result, "failed to create Win32 surface");
+    for (auto& output: outputs)
+    {
+        surfaceInfo.hwnd = output.hWnd;
+        VkResult result = vkCreateWin32SurfaceKHR(instance, &surfaceInfo, allocator.callbacks(VK_OBJECT_TYPE_SURFACE_KHR), &output.surface);
+        CHECK_SUCCEEDED(result, "failed to create Win32 surface");
+    }
 }
 
-void VkApp::createSwapchain()
+void VkApp::createSwapchains()
 {
     VkSwapchainCreateInfoKHR swapchainInfo;
     swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     swapchainInfo.pNext = nullptr;
     swapchainInfo.flags = 0;
-    swapchainInfo.surface = surface;
+    //swapchainInfo.surface = ;
     swapchainInfo.minImageCount = 2;
     swapchainInfo.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
     swapchainInfo.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
     swapchainInfo.imageExtent = VkExtent2D{width, height};
     swapchainInfo.imageArrayLayers = 1;
     swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    swapchainInfo.queueFamilyIndexCount = 0;
-    swapchainInfo.pQueueFamilyIndices = nullptr;
+    // Upscale blits into swapchain images, if every output allows it
+    swapchainTransferDst = true;
+    for (auto const& output: outputs)
+    {
+        VkSurfaceCapabilitiesKHR surfaceCapabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, output.surface, &surfaceCapabilities);
+        if (!(surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+            swapchainTransferDst = false;
+    }
+    if (swapchainTransferDst)
+        swapchainInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    // Present from another family reads the images without ownership transfer
+    const uint32_t queueFamilyIndices[2] = {
+        queueTopology->getFamilyIndex(QueueTopology::Graphics),
+        queueTopology->getFamilyIndex(QueueTopology::Present)
+    };
+    const bool concurrent = (queueFamilyIndices[0] != queueFamilyIndices[1]);
+    swapchainInfo.imageSharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    swapchainInfo.queueFamilyIndexCount = concurrent ? 2 : 0;
+    swapchainInfo.pQueueFamilyIndices = concurrent ? queueFamilyIndices : nullptr;
     swapchainInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
     swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    swapchainInfo.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    //swapchainInfo.presentMode = ;
     swapchainInfo.clipped = VK_TRUE;
     swapchainInfo.oldSwapchain = VK_NULL_HANDLE;
-    VkResult result = vkCreateSwapchainKHR(device, &swapchainInfo, nullptr, &swapchain);
-    CHECK_SUCCEEDED(result, "failed to create swapchain");
 
+    for (auto& output: outputs)
+    {
+        swapchainInfo.surface = output.surface;
+        swapchainInfo.presentMode = choosePresentMode(output.surface, &output == &outputs.front());
+        VkResult result = vkCreateSwapchainKHR(device, &swapchainInfo, allocator.callbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR), &output.swapchain);
+        CHECK_SUCCEEDED(result, "failed to create swapchain");
+
+        uint32_t swapchainImageCount = 0;
+        vkGetSwapchainImagesKHR(device, output.swapchain, &swapchainImageCount, nullptr);
+        output.images.resize(swapchainImageCount);
+        result = vkGetSwapchainImagesKHR(device, output.swapchain, &swapchainImageCount, output.images.data());
+    }
+}
+
+void VkApp::createImageViews()
+{
     VkImageViewCreateInfo imageViewInfo;
     imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     imageViewInfo.pNext = nullptr;
     imageViewInfo.flags = 0;
     //imageViewInfo.image = ;
     imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    imageViewInfo.format = swapchainInfo.imageFormat;
+    imageViewInfo.format = VK_FORMAT_B8G8R8A8_UNORM;
     imageViewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
     imageViewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
     imageViewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -343,22 +647,36 @@ void VkApp::createSwapchain()
     imageViewInfo.subresourceRange.baseArrayLayer = 0;
     imageViewInfo.subresourceRange.layerCount = 1;
 
-    uint32_t swapchainImageCount = 0;
-    vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, nullptr);
-    swapchainImages.resize(swapchainImageCount);
-    result = vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCount, swapchainImages.data());
-    for (auto& image: swapchainImages)
+    for (auto& output: outputs)
+    {
+        for (auto& image: output.images)
+        {
+            imageViewInfo.image = image;
+            VkImageView imageView = VK_NULL_HANDLE;
+            VkResult result = vkCreateImageView(device, &imageViewInfo, allocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &imageView);
+            CHECK_SUCCEEDED(result, "failed to create image view");
+            output.imageViews.push_back(imageView);
+        }
+    }
+}
+
+void VkApp::destroyAttachments()
+{
+    for (auto& output: outputs)
     {
-        imageViewInfo.image = image;
-        VkImageView imageView = VK_NULL_HANDLE;
-        result = vkCreateImageView(device, &imageViewInfo, nullptr, &imageView);
-        CHECK_SUCCEEDED(result, "failed to create image view");
-        swapchainImageViews.push_back(imageView);
+        for (auto framebuffer: output.framebuffers)
+            vkDestroyFramebuffer(device, framebuffer, allocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+        for (auto imageView: output.imageViews)
+            vkDestroyImageView(device, imageView, allocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+        output.framebuffers.clear();
+        output.imageViews.clear();
     }
 }
 
 void VkApp::createRenderPass()
 {
+    if (dynamicRendering)
+        return; // Attachments are given to vkCmdBeginRenderingKHR
     VkAttachmentReference colorAttachment{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
     VkAttachmentDescription colorAttachmentDescription;
     colorAttachmentDescription.flags = 0;
@@ -411,12 +729,14 @@ void VkApp::createRenderPass()
     renderPassInfo.pSubpasses = &subpassDescription;
     renderPassInfo.dependencyCount = 2;
     renderPassInfo.pDependencies = dependencies;
-    VkResult result = vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass);
+    VkResult result = vkCreateRenderPass(device, &renderPassInfo, allocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS), &renderPass);
     CHECK_SUCCEEDED(result, "failed to create render pass");
 }
 
-void VkApp::createFramebuffer()
+void VkApp::createFramebuffers()
 {
+    if (dynamicRendering)
+        return;
     VkFramebufferCreateInfo framebufferInfo;
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebufferInfo.pNext = nullptr;
@@ -428,13 +748,16 @@ void VkApp::createFramebuffer()
     framebufferInfo.height = height;
     framebufferInfo.layers = 1;
 
-    framebuffers.resize(swapchainImageViews.size());
-    uint32_t i = 0;
-    for (VkFramebuffer& framebuffer: framebuffers)
+    for (auto& output: outputs)
     {
-        framebufferInfo.pAttachments = &swapchainImageViews[i++];
-        VkResult result = vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer);
-        CHECK_SUCCEEDED(result, "failed to create framebuffer");
+        output.framebuffers.resize(output.imageViews.size());
+        uint32_t i = 0;
+        for (VkFramebuffer& framebuffer: output.framebuffers)
+        {
+            framebufferInfo.pAttachments = &output.imageViews[i++];
+            VkResult result = vkCreateFramebuffer(device, &framebufferInfo, allocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &framebuffer);
+            CHECK_SUCCEEDED(result, "failed to create framebuffer");
+        }
     }
 }
 
@@ -444,14 +767,14 @@ void VkApp::createCommandPools()
     cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     cmdPoolInfo.pNext = nullptr;
     cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    cmdPoolInfo.queueFamilyIndex = chooseFamilyIndex(VK_QUEUE_GRAPHICS_BIT);
-    VkResult result = vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &graphicsCmdPool);
-    cmdPoolInfo.queueFamilyIndex = chooseFamilyIndex(VK_QUEUE_COMPUTE_BIT);
-    result = vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &computeCmdPool);
+    cmdPoolInfo.queueFamilyIndex = queueTopology->getFamilyIndex(QueueTopology::Graphics);
+    VkResult result = vkCreateCommandPool(device, &cmdPoolInfo, allocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &graphicsCmdPool);
     CHECK_SUCCEEDED(result, "failed to create graphics command pool");
-    cmdPoolInfo.queueFamilyIndex = chooseFamilyIndex(VK_QUEUE_TRANSFER_BIT);
+    cmdPoolInfo.queueFamilyIndex = queueTopology->getFamilyIndex(QueueTopology::Compute);
+    result = vkCreateCommandPool(device, &cmdPoolInfo, allocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &computeCmdPool);
     CHECK_SUCCEEDED(result, "failed to create compute command pool");
-    result = vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &transferCmdPool);
+    cmdPoolInfo.queueFamilyIndex = queueTopology->getFamilyIndex(QueueTopology::Transfer);
+    result = vkCreateCommandPool(device, &cmdPoolInfo, allocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &transferCmdPool);
     CHECK_SUCCEEDED(result, "failed to create transfer command pool");
 }
 
@@ -462,7 +785,7 @@ void VkApp::createCommandBuffers()
     cmdBufferAllocateInfo.pNext = nullptr;
     cmdBufferAllocateInfo.commandPool = graphicsCmdPool;
     cmdBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBufferAllocateInfo.commandBufferCount = (uint32_t)swapchainImages.size();
+    cmdBufferAllocateInfo.commandBufferCount = COMMAND_BUFFER_COUNT;
     cmdBuffers.resize(cmdBufferAllocateInfo.commandBufferCount);
     VkResult result = vkAllocateCommandBuffers(device, &cmdBufferAllocateInfo, cmdBuffers.data());
     CHECK_SUCCEEDED(result, "failed to create graphics command buffers");
@@ -482,8 +805,13 @@ void VkApp::createSyncPrimitices()
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semaphoreInfo.pNext = nullptr;
     semaphoreInfo.flags = 0;
-    VkResult result = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &presentSemaphore);
-    result = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore);
+    VkResult result;
+    for (auto& output: outputs)
+    {
+        result = vkCreateSemaphore(device, &semaphoreInfo, allocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &output.acquireSemaphore);
+        CHECK_SUCCEEDED(result, "failed to create semephore");
+    }
+    result = vkCreateSemaphore(device, &semaphoreInfo, allocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &renderFinishedSemaphore);
     CHECK_SUCCEEDED(result, "failed to create semephore");
 
 #ifdef WAIT_PRESENT_FENCE
@@ -493,96 +821,370 @@ void VkApp::createSyncPrimitices()
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     cmdSubmitFences.resize(cmdBuffers.size());
     for (VkFence& fence: cmdSubmitFences)
-        result = vkCreateFence(device, &fenceInfo, nullptr, &fence);
+        result = vkCreateFence(device, &fenceInfo, allocator.callbacks(VK_OBJECT_TYPE_FENCE), &fence);
     vkResetFences(device, cmdSubmitFences.size(), cmdSubmitFences.data());
 #endif // WAIT_PRESENT_FENCE
 }
 
-uint32_t VkApp::aquireNextImage() const
+void VkApp::createQueryPools()
 {
-    uint32_t imageIndex = 0;
-    VkResult result;
-    do
+    const uint32_t timestampValidBits = queueFamilyProperties[queueTopology->getFamilyIndex(QueueTopology::Graphics)].timestampValidBits;
+    profiler.createQueryPools(physicalDevice, device, timestampValidBits, (uint32_t)cmdBuffers.size(),
+        calibratedTimestamps, enabledFeatures.pipelineStatisticsQuery != VK_FALSE,
+        allocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+}
+
+void VkApp::createVirtualTexture()
+{
+    if (!enabledFeatures.sparseResidencyImage2D || !VirtualTexture::supported(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM))
     {
-        result = vkAcquireNextImageKHR(device, swapchain, TIMEOUT, presentSemaphore, VK_NULL_HANDLE, &imageIndex);
-        if (VK_TIMEOUT == result)
-            OutputDebugStringA("image acquire timeout expired\n");
-    } while (VK_TIMEOUT == result);
-    switch (result)
-    {
-    case VK_NOT_READY:
-        OutputDebugStringA("surface not ready\n");
-        break;
-    case VK_SUBOPTIMAL_KHR:
-        OutputDebugStringA("suboptimal\n");
-        break;
-    }
-    // VK_ERROR_OUT_OF_HOST_MEMORY
-    // VK_ERROR_OUT_OF_DEVICE_MEMORY
-    // VK_ERROR_DEVICE_LOST
-    // VK_ERROR_OUT_OF_DATE_KHR
-    // VK_ERROR_SURFACE_LOST_KHR
-    // VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT
-    CHECK_SUCCEEDED(result, "image acquire failed");
-    return imageIndex;
-}
-
-void VkApp::submit(uint32_t imageIndex)
-{
-    const VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    VkSubmitInfo submitInfo;
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = nullptr;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &presentSemaphore;
-    submitInfo.pWaitDstStageMask = &waitDstStageMask;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &cmdBuffers[imageIndex];
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &renderFinishedSemaphore; // Will be signaled when the command buffers for this batch have completed execution
+        OutputDebugStringA("sparse residency not supported, virtual texturing disabled\n");
+        return;
+    }
+    virtualTexture = std::make_unique<VirtualTexture>(physicalDevice, device, sparseQueue, *submitQueue, allocator,
+        VK_FORMAT_R8G8B8A8_UNORM, VIRTUAL_TEXTURE_SIZE, VIRTUAL_TEXTURE_SIZE, VIRTUAL_TEXTURE_BUDGET);
+}
 
-#ifdef WAIT_PRESENT_FENCE
-    VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, cmdSubmitFences[imageIndex]);
-#else
-    VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-#endif
-    CHECK_SUCCEEDED(result, "queue submission failed");
+void VkApp::createDynamicResolution(bool enable)
+{
+    if (!enable)
+        return;
+    if (!swapchainTransferDst || !DynamicResolution::supported(physicalDevice, VK_FORMAT_B8G8R8A8_UNORM))
+    {
+        OutputDebugStringA("blit to swapchain not supported, dynamic resolution disabled\n");
+        return;
+    }
+    dynamicResolution = std::make_unique<DynamicResolution>(physicalDevice, device, allocator,
+        VK_FORMAT_B8G8R8A8_UNORM, width, height,
+        DYNAMIC_RESOLUTION_TARGET, DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE, dynamicRendering);
+}
+
+void VkApp::createAssetPack(const std::string& fileName)
+{
+    if (fileName.empty())
+        return;
+    std::vector<uint32_t> queueFamilyIndices = {queueTopology->getFamilyIndex(QueueTopology::Graphics)};
+    if (queueTopology->getFamilyIndex(QueueTopology::Transfer) != queueFamilyIndices[0])
+        queueFamilyIndices.push_back(queueTopology->getFamilyIndex(QueueTopology::Transfer));
+    assetPack = std::make_unique<AssetPack>(physicalDevice, device, transferQueue, transferCmdBuffer,
+        *submitQueue, allocator, queueFamilyIndices, externalMemoryHost, fileName.c_str());
+    const AssetPack::Statistics stats = assetPack->getStatistics();
+    char message[256];
+    snprintf(message, sizeof(message), "%s: %u assets, %llu bytes, %s, map: %.3f ms, upload: %.3f ms, %.2f GB/s\n",
+        fileName.c_str(), stats.assetCount, (unsigned long long)stats.bytes,
+        stats.hostImport ? "host memory import" : "staging",
+        stats.mapTime, stats.uploadTime, stats.throughput);
+    OutputDebugStringA(message);
+    if (benchmark)
+        benchmark->addMetric("asset pack load", stats.throughput, "GB/s");
+}
+
+void VkApp::createUniformRing()
+{
+    uniformRing = std::make_unique<UniformRing>(physicalDevice, device, allocator,
+        UNIFORM_RING_FRAME_SIZE, (uint32_t)cmdBuffers.size(), UNIFORM_RING_BINDING_RANGE);
+    if (!uniformRing->getStatistics().deviceLocal)
+        OutputDebugStringA("no device local host visible memory, uniforms are read from system memory\n");
+}
+
+void VkApp::updateFrameConstants()
+{   // Segment of this frame index was released by the fence wait of its previous frame
+    uniformRing->beginFrame(frameIndex);
+    const VkExtent2D extent = dynamicResolution ? dynamicResolution->getRenderExtent() : VkExtent2D{width, height};
+    FrameConstants constants;
+    constants.time = elapsedTime;
+    constants.deltaTime = deltaTime;
+    constants.resolutionScale = dynamicResolution ? dynamicResolution->getScale() : 1.f;
+    constants.frameIndex = frameIndex;
+    constants.viewport[0] = (float)extent.width;
+    constants.viewport[1] = (float)extent.height;
+    constants.viewport[2] = 1.f / extent.width;
+    constants.viewport[3] = 1.f / extent.height;
+    frameConstantsOffset = uniformRing->push(constants);
+}
+
+void VkApp::createPipelines(bool warmUp)
+{
+    const VkDescriptorSetLayout setLayout = uniformRing->getDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo;
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pNext = nullptr;
+    pipelineLayoutInfo.flags = 0;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &pipelineLayout);
+    CHECK_SUCCEEDED(result, "failed to create pipeline layout");
+
+    pipelineCompiler = std::make_unique<PipelineCompiler>(device, pipelineLayout, allocator, profiler,
+        std::max(std::thread::hardware_concurrency(), 1u), dynamicRendering);
+    // Offscreen pass of dynamic resolution has the same attachment, so it is compatible
+    const uint32_t renderPassIndex = dynamicRendering ? PipelineCompiler::dynamicRenderingPass :
+        pipelineCompiler->addRenderPass(renderPass);
+    auto desc = [this, renderPassIndex](const char *fragmentShader)
+    {
+        const char *vertexShader = "shaders/fullscreen.vert.spv";
+        if (dynamicRendering)
+            return PipelineCompiler::dynamicRenderingDesc(vertexShader, fragmentShader, VK_FORMAT_B8G8R8A8_UNORM);
+        return PipelineCompiler::graphicsDesc(vertexShader, fragmentShader, renderPassIndex);
+    };
+    if (warmUp)
+    {
+        const uint32_t pipelineCount = pipelineCompiler->warmUp(PIPELINE_LIST_FILE);
+        const PipelineCompiler::Statistics stats = pipelineCompiler->getStatistics();
+        char message[128];
+        snprintf(message, sizeof(message), "warm-up: %u pipelines compiled in %.3f ms\n", pipelineCount, stats.warmUpTime);
+        OutputDebugStringA(message);
+        if (benchmark)
+            benchmark->addMetric("pipeline warm-up", stats.warmUpTime, "ms");
+    }
+    // Placeholder is cheap, wait for it; the sky resolves in the background
+    placeholderPipeline = pipelineCompiler->request(desc("shaders/solid.frag.spv"));
+    pipelineCompiler->wait(placeholderPipeline);
+    skyPipeline = pipelineCompiler->request(desc("shaders/sky.frag.spv"), placeholderPipeline);
+}
+
+void VkApp::draw(VkCommandBuffer cmdBuffer, VkExtent2D extent)
+{
+    const VkPipeline pipeline = pipelineCompiler->get(skyPipeline);
+    if (VK_NULL_HANDLE == pipeline)
+        return; // Shaders not built
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    const VkViewport viewport = {0.f, 0.f, (float)extent.width, (float)extent.height, 0.f, 1.f};
+    const VkRect2D scissor = {{0, 0}, extent};
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+    const VkDescriptorSet descriptorSet = uniformRing->getDescriptorSet();
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &frameConstantsOffset);
+    vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+}
+
+void VkApp::recordRendering(VkCommandBuffer cmdBuffer, VkImage image, VkImageView imageView, VkExtent2D extent,
+    const VkClearValue& clearValue, VkImageLayout finalLayout)
+{   // Barriers that the render pass would have done with its layouts and external dependencies
+    const bool present = (VK_IMAGE_LAYOUT_PRESENT_SRC_KHR == finalLayout);
+    VkImageMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = 0; // Contents are discarded
+    barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    // Swapchain image is released by the acquire semaphore wait at this stage,
+    // offscreen image was last read by the upscale blit of the previous frame
+    const VkPipelineStageFlags srcStageMask = present ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, srcStageMask, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkRenderingAttachmentInfoKHR colorAttachment;
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.pNext = nullptr;
+    colorAttachment.imageView = imageView;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+    colorAttachment.resolveImageView = VK_NULL_HANDLE;
+    colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearValue;
+
+    VkRenderingInfoKHR renderingInfo;
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.pNext = nullptr;
+    renderingInfo.flags = 0;
+    renderingInfo.renderArea = {{0, 0}, extent};
+    renderingInfo.layerCount = 1;
+    renderingInfo.viewMask = 0;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = nullptr;
+    renderingInfo.pStencilAttachment = nullptr;
+    vkCmdBeginRenderingKHR(cmdBuffer, &renderingInfo);
+    draw(cmdBuffer, extent);
+    vkCmdEndRenderingKHR(cmdBuffer);
+
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = present ? 0 : VK_ACCESS_TRANSFER_READ_BIT; // Present is ordered by semaphore
+    barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    const VkPipelineStageFlags dstStageMask = present ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, dstStageMask, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void VkApp::measureRecreateLatency()
+{   // What a swapchain resize costs besides the swapchain itself
+    vkDeviceWaitIdle(device);
+    const auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < RECREATE_ITERATIONS; ++i)
+    {
+        destroyAttachments();
+        createImageViews();
+        createFramebuffers();
+    }
+    const std::chrono::duration<float, std::milli> duration = std::chrono::steady_clock::now() - begin;
+    const float latency = duration.count() / RECREATE_ITERATIONS;
+    char message[128];
+    snprintf(message, sizeof(message), "attachment recreate: %.3f ms (%s)\n", latency,
+        dynamicRendering ? "dynamic rendering" : "render pass");
+    OutputDebugStringA(message);
+    benchmark->addMetric(dynamicRendering ? "attachment recreate (dynamic rendering)" : "attachment recreate (render pass)",
+        latency, "ms");
+}
+
+void VkApp::aquireNextImages()
+{
+    uint32_t activeCount = 0;
+    for (auto& output: outputs)
+    {
+        if (!output.active)
+            continue;
+        VkResult result;
+        do
+        {
+            result = vkAcquireNextImageKHR(device, output.swapchain, TIMEOUT, output.acquireSemaphore, VK_NULL_HANDLE, &output.imageIndex);
+            if (VK_TIMEOUT == result)
+                OutputDebugStringA("image acquire timeout expired\n");
+        } while (VK_TIMEOUT == result);
+        switch (result)
+        {
+        case VK_NOT_READY:
+            OutputDebugStringA("surface not ready\n");
+            break;
+        case VK_SUBOPTIMAL_KHR:
+            OutputDebugStringA("suboptimal\n");
+            result = VK_SUCCESS;
+            break;
+        case VK_ERROR_OUT_OF_DATE_KHR:
+        case VK_ERROR_SURFACE_LOST_KHR:
+            deactivateOutput(output, "image acquire failed");
+            continue;
+        }
+        // VK_ERROR_OUT_OF_HOST_MEMORY
+        // VK_ERROR_OUT_OF_DEVICE_MEMORY
+        // VK_ERROR_DEVICE_LOST
+        // VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT
+        CHECK_SUCCEEDED(result, "image acquire failed");
+        ++activeCount;
+    }
+    if (!activeCount)
+        throw std::runtime_error("all outputs lost");
 }
 
-void VkApp::present(uint32_t imageIndex)
+void VkApp::submit(VkSemaphore bindSemaphore)
 {
-    VkPresentInfoKHR presentInfo;
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.pNext = nullptr;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &renderFinishedSemaphore; // Wait for command buffers have completed execution before issuing the present request
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = &swapchain;
-    presentInfo.pImageIndices = &imageIndex;
-    presentInfo.pResults = nullptr;
+    SubmitQueue::Batch batch;
+    batch.queue = graphicsQueue;
+    batch.cmdBuffers.push_back(cmdBuffers[frameIndex]);
+    for (auto const& output: outputs)
+    {
+        if (output.active)
+        {
+            batch.waitSemaphores.push_back(output.acquireSemaphore);
+            batch.waitDstStageMasks.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        }
+    }
+    if (bindSemaphore != VK_NULL_HANDLE)
+    {   // Tile uploads must wait until their pages are bound
+        batch.waitSemaphores.push_back(bindSemaphore);
+        batch.waitDstStageMasks.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+    batch.signalSemaphores.push_back(renderFinishedSemaphore); // Will be signaled when the command buffers for this batch have completed execution
+#ifdef WAIT_PRESENT_FENCE
+    batch.fence = cmdSubmitFences[frameIndex];
+#endif
+    submitQueue->submit(std::move(batch));
+}
 
-    VkResult result = vkQueuePresentKHR(graphicsQueue, &presentInfo);
-    CHECK_SUCCEEDED(result, "present failed");
+void VkApp::present()
+{   // One vkQueuePresentKHR carries all swapchains
+    SubmitQueue::Present present;
+    present.queue = presentQueue;
+    present.waitSemaphores.push_back(renderFinishedSemaphore); // Wait for command buffers have completed execution before issuing the present request
+    for (auto const& output: outputs)
+    {
+        if (output.active)
+        {
+            present.swapchains.push_back(output.swapchain);
+            present.imageIndices.push_back(output.imageIndex);
+        }
+    }
+    submitQueue->present(std::move(present));
 }
 
-void VkApp::waitForPresentComplete(uint32_t imageIndex)
+void VkApp::waitForPresentComplete()
 {
     VkResult result;
 #ifdef WAIT_PRESENT_FENCE
     do
     {
-        result = vkWaitForFences(device, 1, &cmdSubmitFences[imageIndex], VK_FALSE, TIMEOUT);
+        result = vkWaitForFences(device, 1, &cmdSubmitFences[frameIndex], VK_FALSE, TIMEOUT);
         if (VK_TIMEOUT == result)
+        {   // Fence is never signaled if the submit thread failed
             OutputDebugStringA("wait for fence timeout expired\n");
+            submitQueue->checkError();
+        }
     } while (VK_TIMEOUT == result);
     CHECK_SUCCEEDED(result, "wait for fence failed");
-    vkResetFences(device, 1, &cmdSubmitFences[imageIndex]);
+    vkResetFences(device, 1, &cmdSubmitFences[frameIndex]);
 #else
+    submitQueue->flush();
     result = vkDeviceWaitIdle(device);
     CHECK_SUCCEEDED(result, "wait for device to become idle failed");
 #endif // !WAIT_PRESENT_FENCE
 }
 
+void VkApp::checkPresentResults()
+{   // Submit thread reports per-swapchain results of the latest present
+    for (auto const& presentResult: submitQueue->getPresentResults())
+    {
+        if ((VK_ERROR_OUT_OF_DATE_KHR == presentResult.result) ||
+            (VK_ERROR_SURFACE_LOST_KHR == presentResult.result))
+        {
+            auto it = std::find_if(outputs.begin(), outputs.end(),
+                [&presentResult](auto const& output)
+                {
+                    return output.swapchain == presentResult.swapchain;
+                });
+            if ((it != outputs.end()) && it->active)
+                deactivateOutput(*it, "present failed");
+        }
+    }
+}
+
+void VkApp::deactivateOutput(Output& output, const char *reason)
+{
+    char message[64];
+    snprintf(message, sizeof(message), "output %u: %s, dropped\n", (uint32_t)(&output - outputs.data()), reason);
+    OutputDebugStringA(message);
+    output.active = false;
+}
+
+VkPresentModeKHR VkApp::choosePresentMode(VkSurfaceKHR surface, bool primary) const
+{   // Primary output paces the frame. Secondary outputs prefer mailbox,
+    // so that a shared present never blocks on their vertical blank.
+    uint32_t presentModeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr);
+    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+    if (presentModeCount)
+        vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, presentModes.data());
+    const VkPresentModeKHR primaryModes[] = {VK_PRESENT_MODE_IMMEDIATE_KHR};
+    const VkPresentModeKHR secondaryModes[] = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR};
+    const VkPresentModeKHR *preferredModes = primary ? primaryModes : secondaryModes;
+    const size_t preferredCount = primary ? _countof(primaryModes) : _countof(secondaryModes);
+    for (size_t i = 0; i < preferredCount; ++i)
+    {
+        if (std::find(presentModes.begin(), presentModes.end(), preferredModes[i]) != presentModes.end())
+            return preferredModes[i];
+    }
+    return VK_PRESENT_MODE_FIFO_KHR; // Always supported
+}
+
 bool VkApp::findExtension(const char *extensionName) const
 {
     auto it = std::find_if(extensionProperties.begin(), extensionProperties.end(),
@@ -593,45 +1195,6 @@ bool VkApp::findExtension(const char *extensionName) const
     return it != extensionProperties.end();
 }
 
-uint32_t VkApp::chooseFamilyIndex(VkQueueFlagBits queueType) const
-{
-    uint32_t queueFamilyIndex = 0;
-    if (VK_QUEUE_COMPUTE_BIT == queueType)
-    {
-        for (auto const& property: queueFamilyProperties)
-        {
-            if (property.queueFlags & queueType)
-            {
-                const VkFlags hasGraphics = property.queueFlags & VK_QUEUE_GRAPHICS_BIT;
-                if (!hasGraphics)
-                    return queueFamilyIndex;
-            }
-            ++queueFamilyIndex;
-        }
-    }
-    else if ((VK_QUEUE_TRANSFER_BIT == queueType) || (VK_QUEUE_SPARSE_BINDING_BIT == queueType))
-    {
-        for (auto const& property: queueFamilyProperties)
-        {
-            if (property.queueFlags & queueType)
-            {
-                const VkFlags hasGraphicsOrCompute = property.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
-                if (!hasGraphicsOrCompute)
-                    return queueFamilyIndex;
-            }
-            ++queueFamilyIndex;
-        }
-    }
-    queueFamilyIndex = 0;
-    for (auto const& property: queueFamilyProperties)
-    {   // Try to find any suitable family
-        if (property.queueFlags & queueType)
-            return queueFamilyIndex;
-        ++queueFamilyIndex;
-    }
-    return 0;
-}
-
 std::unique_ptr<Win32App> appFactory(const Win32App::Entry& entry)
 {
     return std::make_unique<VkApp>(entry, "Vulkan", SCREEN_WIDTH, SCREEN_HEIGHT);
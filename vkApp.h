@@ -4,6 +4,16 @@
 #include <vulkan/vulkan.h>
 #include "win32App.h"
 #include "timer.h"
+#include "allocator.h"
+#include "submitQueue.h"
+#include "profiler.h"
+#include "benchmark.h"
+#include "virtualTexture.h"
+#include "dynamicResolution.h"
+#include "assetPack.h"
+#include "uniformRing.h"
+#include "pipelineCompiler.h"
+#include "queueTopology.h"
 
 class VkApp : public Win32App
 {
@@ -15,51 +25,112 @@ public:
     void onPaint() override;
 
 private:
+    struct Output
+    {
+        HWND hWnd = NULL;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
+        VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+        VkSemaphore acquireSemaphore = VK_NULL_HANDLE;
+        std::vector<VkImage> images;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkFramebuffer> framebuffers;
+        uint32_t imageIndex = 0;
+        bool active = true; // Cleared when surface is lost or out of date
+    };
+
+    struct FrameConstants
+    {
+        float time; // Seconds since start
+        float deltaTime; // Milliseconds
+        float resolutionScale;
+        uint32_t frameIndex;
+        float viewport[4]; // Width, height, 1/width, 1/height
+    };
+
     void createInstance();
     void createPhysicalDevice();
     void createLogicalDevice();
-    void createWin32Surface();
-    void createSwapchain();
+    void createOutputWindows(uint32_t outputCount);
+    void createWin32Surfaces();
+    void createSwapchains();
+    void createImageViews();
+    void destroyAttachments();
     void createRenderPass();
-    void createFramebuffer();
+    void createFramebuffers();
     void createCommandPools();
     void createCommandBuffers();
     void createSyncPrimitices();
-    uint32_t aquireNextImage() const;
-    void submit(uint32_t imageIndex);
-    void present(uint32_t imageIndex);
-    void waitForPresentComplete(uint32_t imageIndex);
+    void createQueryPools();
+    void createVirtualTexture();
+    void createDynamicResolution(bool enable);
+    void createAssetPack(const std::string& fileName);
+    void createUniformRing();
+    void createPipelines(bool warmUp);
+    void updateFrameConstants();
+    void draw(VkCommandBuffer cmdBuffer, VkExtent2D extent);
+    void recordRendering(VkCommandBuffer cmdBuffer, VkImage image, VkImageView imageView, VkExtent2D extent,
+        const VkClearValue& clearValue, VkImageLayout finalLayout);
+    void measureRecreateLatency();
+    void aquireNextImages();
+    void submit(VkSemaphore bindSemaphore);
+    void present();
+    void waitForPresentComplete();
+    void checkPresentResults();
+    void deactivateOutput(Output& output, const char *reason);
+    VkPresentModeKHR choosePresentMode(VkSurfaceKHR surface, bool primary) const;
     bool findExtension(const char *extensionName) const;
-    uint32_t chooseFamilyIndex(VkQueueFlagBits queueType) const;
 
+    HostAllocator allocator;
     VkInstance instance = VK_NULL_HANDLE;
     VkDebugReportCallbackEXT debugReportCallback = VK_NULL_HANDLE;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device = VK_NULL_HANDLE;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
+    VkQueue presentQueue = VK_NULL_HANDLE;
     VkQueue computeQueue = VK_NULL_HANDLE;
     VkQueue transferQueue = VK_NULL_HANDLE;
-    VkSurfaceKHR surface = VK_NULL_HANDLE;
-    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    VkQueue sparseQueue = VK_NULL_HANDLE;
     VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
     VkCommandPool graphicsCmdPool = VK_NULL_HANDLE;
     VkCommandPool computeCmdPool = VK_NULL_HANDLE;
     VkCommandPool transferCmdPool = VK_NULL_HANDLE;
     VkCommandBuffer computeCmdBuffer = VK_NULL_HANDLE;
     VkCommandBuffer transferCmdBuffer = VK_NULL_HANDLE;
-    VkSemaphore presentSemaphore = VK_NULL_HANDLE;
     VkSemaphore renderFinishedSemaphore = VK_NULL_HANDLE;
 
+    VkPhysicalDeviceFeatures enabledFeatures = {};
+    bool calibratedTimestamps = false;
+    bool swapchainTransferDst = false;
+    bool externalMemoryHost = false;
+    bool dynamicRendering = false; // Without render pass and framebuffer objects
+    PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR = nullptr;
+    PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR = nullptr;
+
     std::vector<VkExtensionProperties> extensionProperties;
     std::vector<VkQueueFamilyProperties> queueFamilyProperties;
-    std::vector<VkImage> swapchainImages;
-    std::vector<VkImageView> swapchainImageViews;
-    std::vector<VkFramebuffer> framebuffers;
+    std::vector<Output> outputs;
     std::vector<VkCommandBuffer> cmdBuffers;
     std::vector<VkFence> cmdSubmitFences;
+    std::unique_ptr<QueueTopology> queueTopology;
+    std::unique_ptr<SubmitQueue> submitQueue;
+    std::unique_ptr<VirtualTexture> virtualTexture;
+    std::unique_ptr<DynamicResolution> dynamicResolution;
+    std::unique_ptr<AssetPack> assetPack;
+    std::unique_ptr<UniformRing> uniformRing;
+    std::unique_ptr<PipelineCompiler> pipelineCompiler;
+    PipelineCompiler::Handle placeholderPipeline = PipelineCompiler::invalidHandle;
+    PipelineCompiler::Handle skyPipeline = PipelineCompiler::invalidHandle;
 
     Timer timer;
+    Profiler profiler;
+    std::unique_ptr<Benchmark> benchmark;
+    uint32_t frameIndex = 0;
     float time = 0.f;
+    float elapsedTime = 0.f; // Seconds
+    float deltaTime = 0.f;
+    uint32_t frameConstantsOffset = 0; // Dynamic offset into uniformRing
     uint32_t frameCount = 0;
     uint32_t fps = 0;
+    float panAngle = 0.f;
 };
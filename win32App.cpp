@@ -45,22 +45,37 @@ Win32App::Win32App(const Entry& entry, LPCTSTR caption, uint32_t width_, uint32_
     {
         style = WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX;
     }
-    hWnd = CreateWindow(wc.lpszClassName, caption, style,
-        0, 0, width, height,
-        NULL, NULL, wc.hInstance, NULL);
-    SetWindowText(hWnd, caption);
-
-    RECT rc = {0L, 0L, (LONG)width, (LONG)height};
-    AdjustWindowRect(&rc, style, FALSE);
-    SetWindowPos(hWnd, HWND_TOP, 0, 0, rc.right - rc.left, rc.bottom - rc.top, SWP_HIDEWINDOW);
+    hWnd = createWindow(caption, style);
 }
 
 Win32App::~Win32App()
 {
+    for (HWND hExtraWnd: extraWindows)
+        DestroyWindow(hExtraWnd);
     DestroyWindow(hWnd);
     UnregisterClass(ClassName, hInstance);
 }
 
+HWND Win32App::addWindow(LPCTSTR caption)
+{   // Additional outputs are always windowed
+    HWND hExtraWnd = createWindow(caption, WS_CAPTION | WS_SYSMENU | WS_MINIMIZEBOX);
+    extraWindows.push_back(hExtraWnd);
+    return hExtraWnd;
+}
+
+HWND Win32App::createWindow(LPCTSTR caption, DWORD style) const
+{
+    HWND hNewWnd = CreateWindow(ClassName, caption, style,
+        0, 0, width, height,
+        NULL, NULL, hInstance, NULL);
+    SetWindowText(hNewWnd, caption);
+
+    RECT rc = {0L, 0L, (LONG)width, (LONG)height};
+    AdjustWindowRect(&rc, style, FALSE);
+    SetWindowPos(hNewWnd, HWND_TOP, 0, 0, rc.right - rc.left, rc.bottom - rc.top, SWP_HIDEWINDOW);
+    return hNewWnd;
+}
+
 void Win32App::show() const
 {
     if (fullscreen)
@@ -84,6 +99,14 @@ void Win32App::show() const
         }
         SetWindowPos(hWnd, HWND_TOP, x, y, cx, cy, SWP_SHOWWINDOW);
     }
+    int offset = 0;
+    for (HWND hExtraWnd: extraWindows)
+    {   // Cascade from the top-left corner
+        offset += 32;
+        RECT rc;
+        GetWindowRect(hExtraWnd, &rc);
+        SetWindowPos(hExtraWnd, HWND_TOP, offset, offset, rc.right - rc.left, rc.bottom - rc.top, SWP_SHOWWINDOW);
+    }
     ShowCursor(FALSE);
 }
 
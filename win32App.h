@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <vector>
 #include <windows.h>
 
 class Win32App
@@ -19,12 +20,16 @@ public:
     virtual void onRawMouseWheel(float z) {}
 
 protected:
+    HWND addWindow(LPCTSTR caption);
+
     HINSTANCE hInstance;
     HWND hWnd;
+    std::vector<HWND> extraWindows;
     uint32_t width, height;
     bool fullscreen;
 
 private:
+    HWND createWindow(LPCTSTR caption, DWORD style) const;
     static LRESULT WINAPI wndProc(HWND, UINT, WPARAM, LPARAM);
 
     static Win32App *self;